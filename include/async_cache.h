@@ -0,0 +1,320 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <concepts>
+#include <coroutine>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "async_tool.h"
+#include "singleflight.h"
+
+namespace async {
+
+struct cache_options {
+  size_t byte_budget{(size_t)64 << 20};
+  std::chrono::steady_clock::duration ttl{std::chrono::seconds{60}};
+};
+
+struct cache_stats {
+  size_t hits;
+  size_t stale_hits;
+  size_t misses;
+  size_t evictions;
+};
+
+template <typename K, typename V>
+struct default_cache_sizer {
+  size_t operator()(const K&, const V&) const noexcept {
+    return sizeof(K) + sizeof(V);
+  }
+};
+
+/**
+ * @brief 协程结果的记忆化缓存 (sharded, CLOCK 淘汰, TTL, stale-while-revalidate)
+ * * 用法: `V value = co_await c.get(key, factory);`
+ * * 命中且未过期时不挂起, 直接返回缓存值的拷贝; 未命中时通过 singleflight 合并并发加载,
+ * 由 leader `co_await factory()` 并写入缓存. factory 抛出的异常不会被缓存.
+ * * `co_await c.get(key, factory, executor);` 开启 stale-while-revalidate: 过期条目被返回一次,
+ * 同时在 executor 上后台刷新; 刷新期间的其他请求与刷新合并, 等待新值.
+ * * 淘汰: 每个分片独立维护字节预算 (byte_budget / Shards), 超出时按 CLOCK 淘汰,
+ * 已过期的条目优先淘汰. 条目字节数由 Sizer 计算.
+ */
+template <typename K, std::copy_constructible V, typename Hash = std::hash<K>,
+          std::invocable<const K&, const V&> Sizer = default_cache_sizer<K, V>,
+          size_t Shards = 16>
+  requires(Shards > 0)
+class cache {
+ public:
+  using clock_t = std::chrono::steady_clock;
+
+ private:
+  struct entry {
+    K key;
+    V value;
+    clock_t::time_point expires;
+    size_t bytes;
+    bool referenced{true};
+    bool refreshing{false};
+  };
+
+  struct alignas(64) shard {
+    std::mutex mutex;
+    std::unordered_map<K, size_t, Hash> index;
+    std::vector<std::optional<entry>> slots;
+    std::vector<size_t> free_slots;
+    size_t hand{0};
+    size_t bytes{0};
+  };
+
+  enum class lookup_status : uint8_t { miss, hit, stale };
+
+  struct no_refresh_t {};
+
+  cache_options options;
+  size_t shard_budget;
+  [[no_unique_address]] Sizer sizer{};
+  std::array<shard, Shards> shards;
+  singleflight<K, V, Hash> flights;
+
+  std::atomic<size_t> hits{0};
+  std::atomic<size_t> stale_hits{0};
+  std::atomic<size_t> misses{0};
+  std::atomic<size_t> evictions{0};
+
+  shard& shard_of(const K& key) {
+    return shards[Hash{}(key) % Shards];
+  }
+
+  lookup_status lookup(const K& key, std::optional<V>& out, bool allow_stale) {
+    auto& s = shard_of(key);
+    std::lock_guard lock{s.mutex};
+    auto it = s.index.find(key);
+    if (it == s.index.end()) {
+      return lookup_status::miss;
+    }
+    auto& e = *s.slots[it->second];
+    if (clock_t::now() < e.expires) {
+      e.referenced = true;
+      out.emplace(e.value);
+      return lookup_status::hit;
+    }
+    if (allow_stale && !e.refreshing) {
+      e.refreshing = true;
+      out.emplace(e.value);
+      return lookup_status::stale;
+    }
+    return lookup_status::miss;
+  }
+
+  void erase_slot(shard& s, size_t slot) {
+    s.bytes -= s.slots[slot]->bytes;
+    s.index.erase(s.slots[slot]->key);
+    s.slots[slot].reset();
+    s.free_slots.push_back(slot);
+  }
+
+  void evict_one(shard& s, clock_t::time_point now) {
+    while (true) {
+      const size_t slot = s.hand;
+      s.hand = s.hand + 1 == s.slots.size() ? 0 : s.hand + 1;
+      auto& e = s.slots[slot];
+      if (!e) {
+        continue;
+      }
+      const bool expired = !(now < e->expires) && !e->refreshing;
+      if (e->referenced && !expired) {
+        e->referenced = false;  // second chance
+        continue;
+      }
+      erase_slot(s, slot);
+      evictions.fetch_add(1, std::memory_order_relaxed);
+      return;
+    }
+  }
+
+  void clear_refreshing(const K& key) {
+    auto& s = shard_of(key);
+    std::lock_guard lock{s.mutex};
+    if (auto it = s.index.find(key); it != s.index.end()) {
+      s.slots[it->second]->refreshing = false;
+    }
+  }
+
+  template <typename F>
+  static co_task_with<V> load(cache& c, K key, F factory) {
+    V value = co_await factory();
+    c.put(key, value);
+    co_return value;
+  }
+
+  template <typename F>
+  auto loader(K key, F factory) {
+    return [this, key = std::move(key), factory = std::move(factory)]() {
+      return load(*this, key, factory);
+    };
+  }
+
+  template <typename F, typename Executor>
+  static co_task refresh(cache& c, K key, F factory, Executor& executor) {
+    co_await execute_by(executor);
+    try {
+      co_await c.flights.run(key, c.loader(key, std::move(factory)));
+    } catch (...) {
+      c.clear_refreshing(key);  // 刷新失败, 保留旧值, 下一次请求重新触发刷新
+    }
+  }
+
+ public:
+  template <typename F, typename Executor>
+  struct awaiter {
+    cache& c;
+    K key;
+    F factory;
+    Executor* executor;
+    std::optional<V> value;
+    std::exception_ptr e_ptr;
+
+    static constexpr bool stale_while_revalidate = !std::is_same_v<Executor, no_refresh_t>;
+
+    co_task launch(std::coroutine_handle<> h) {
+      try {
+        value.emplace(co_await c.flights.run(key, c.loader(key, std::move(factory))));
+      } catch (...) {
+        e_ptr = std::current_exception();
+      }
+      h.resume();
+    }
+
+    bool await_ready() {
+      switch (c.lookup(key, value, stale_while_revalidate)) {
+        case lookup_status::hit:
+          c.hits.fetch_add(1, std::memory_order_relaxed);
+          return true;
+        case lookup_status::stale:
+          c.stale_hits.fetch_add(1, std::memory_order_relaxed);
+          if constexpr (stale_while_revalidate) {
+            refresh(c, key, std::move(factory), *executor).detach();
+          }
+          return true;
+        default:
+          c.misses.fetch_add(1, std::memory_order_relaxed);
+          return false;
+      }
+    }
+
+    void await_suspend(std::coroutine_handle<> h) {
+      launch(h).detach();
+    }
+
+    V await_resume() {
+      if (e_ptr) {
+        std::rethrow_exception(e_ptr);
+      }
+      return std::move(*value);
+    }
+  };
+
+  explicit cache(cache_options options = {})
+      : options{options}, shard_budget{std::max<size_t>(1, options.byte_budget / Shards)} {}
+
+  /**
+   * @param factory 无参可调用对象, 返回 co_await 结果可转换为 V 的 awaitable
+   */
+  template <std::invocable F>
+    requires co_awaitable<std::invoke_result_t<F>>
+  awaiter<F, no_refresh_t> get(K key, F factory) {
+    return {.c = *this, .key = std::move(key), .factory = std::move(factory), .executor = nullptr};
+  }
+
+  /**
+   * @brief stale-while-revalidate 版本, 过期条目的后台刷新在 executor 上执行
+   * @warning executor 的生命周期须覆盖所有后台刷新
+   */
+  template <std::invocable F, typename Executor>
+    requires co_awaitable<std::invoke_result_t<F>>
+  awaiter<F, Executor> get(K key, F factory, Executor& executor) {
+    return {.c = *this,
+            .key = std::move(key),
+            .factory = std::move(factory),
+            .executor = std::addressof(executor)};
+  }
+
+  void put(const K& key, V value) {
+    put(key, std::move(value), options.ttl);
+  }
+
+  void put(const K& key, V value, clock_t::duration ttl) {
+    const size_t bytes = std::invoke(sizer, key, value);
+    const auto now = clock_t::now();
+    auto& s = shard_of(key);
+    std::lock_guard lock{s.mutex};
+    if (auto it = s.index.find(key); it != s.index.end()) {
+      erase_slot(s, it->second);
+    }
+    while (s.bytes + bytes > shard_budget && !s.index.empty()) {
+      evict_one(s, now);
+    }
+    size_t slot{};
+    if (s.free_slots.empty()) {
+      slot = s.slots.size();
+      s.slots.emplace_back();
+    } else {
+      slot = s.free_slots.back();
+      s.free_slots.pop_back();
+    }
+    s.slots[slot].emplace(
+        entry{.key = key, .value = std::move(value), .expires = now + ttl, .bytes = bytes});
+    s.index.emplace(key, slot);
+    s.bytes += bytes;
+  }
+
+  bool erase(const K& key) {
+    auto& s = shard_of(key);
+    std::lock_guard lock{s.mutex};
+    auto it = s.index.find(key);
+    if (it == s.index.end()) {
+      return false;
+    }
+    erase_slot(s, it->second);
+    return true;
+  }
+
+  size_t size() {
+    size_t count = 0;
+    for (auto& s : shards) {
+      std::lock_guard lock{s.mutex};
+      count += s.index.size();
+    }
+    return count;
+  }
+
+  size_t bytes() {
+    size_t count = 0;
+    for (auto& s : shards) {
+      std::lock_guard lock{s.mutex};
+      count += s.bytes;
+    }
+    return count;
+  }
+
+  cache_stats stats() const noexcept {
+    return {.hits = hits.load(std::memory_order_relaxed),
+            .stale_hits = stale_hits.load(std::memory_order_relaxed),
+            .misses = misses.load(std::memory_order_relaxed),
+            .evictions = evictions.load(std::memory_order_relaxed)};
+  }
+};
+
+}  // namespace async
@@ -3,16 +3,19 @@
 #include <algorithm>
 #include <array>
 #include <atomic>
+#include <chrono>
 #include <concepts>
 #include <coroutine>
 #include <cstddef>
 #include <exception>
+#include <expected>
 #include <functional>
 #include <future>
 #include <iterator>
 #include <memory>
 #include <optional>
 #include <ranges>
+#include <stop_token>
 #include <thread>
 #include <tuple>
 #include <type_traits>
@@ -146,6 +149,31 @@ struct value_storage<T> : public value_storage_base<value_storage<T>> {
   }
 };
 
+/**
+ * @brief 以值传递错误的返回类型 (std::expected)
+ * * 用法: `co_task_with<result<T, E>>` 中 `co_return fail(e);`, 错误作为返回值沿 co_await 传递,
+ * 不经过 throw / unhandled_exception / rethrow_exception.
+ */
+template <typename T, typename E>
+using result = std::expected<T, E>;
+
+/**
+ * @brief 构造错误结果, 可隐式转换为任意 result<T, E>
+ */
+template <typename E>
+auto fail(E&& error) {
+  return std::unexpected<std::decay_t<E>>{std::forward<E>(error)};
+}
+
+template <typename T>
+struct is_result : public std::false_type {};
+
+template <typename T, typename E>
+struct is_result<result<T, E>> : public std::true_type {};
+
+template <typename T>
+constexpr bool is_result_v = is_result<std::remove_cvref_t<T>>::value;
+
 struct guarded_co_handle {
   std::coroutine_handle<> h;
 
@@ -476,6 +504,24 @@ struct co_task_with {
     void unhandled_exception() {
       this->retval.e_ptr = std::current_exception();
     }
+
+    /**
+     * @brief 不经过 final_suspend 提前结束协程 (供 unwrap 等 awaiter 使用).
+     * @warning 调用时本协程必须处于挂起状态; 调用后不得再访问本协程帧.
+     */
+    template <typename U>
+      requires std::convertible_to<U, T>
+    void early_return(U&& value) {
+      this->retval.set(std::forward<U>(value));
+      auto self = std::coroutine_handle<promise_type>::from_promise(*this);
+      auto _next = next;
+      next = nullptr;
+      if (_next) {
+        _next.resume();  // 等待者在 await_resume 中 destroy 本协程帧
+      } else {
+        self.destroy();  // detach 的情形, 与 final_suspend 不挂起时一致
+      }
+    }
   };
 
   /**
@@ -796,6 +842,14 @@ using cancellable_function = cancellable_function_<false, R, Args...>;
 template <typename R, typename... Args>
 using copyable_cancellable_function = cancellable_function_<true, R, Args...>;
 
+/**
+ * @brief Concept: Executor 是否支持直接投递协程句柄 (customization point `schedule(handle)`)
+ * * 满足时, execute_by / async_call 直接投递 std::coroutine_handle<>, 不做类型擦除.
+ */
+template <typename Executor>
+concept handle_scheduler =
+    requires(Executor&& executor, std::coroutine_handle<> h) { executor.schedule(h); };
+
 template <typename Executor>
 struct execute_by_awaitable {
   Executor executor;
@@ -803,8 +857,12 @@ struct execute_by_awaitable {
     return false;
   }
   void await_suspend(std::coroutine_handle<> h) {
-    executor(cancellable_function<void>::derived_without_cancel{
-        [gh = guarded_co_handle{h}]() mutable { gh.release().resume(); }});
+    if constexpr (handle_scheduler<Executor>) {
+      executor.schedule(h);
+    } else {
+      executor(cancellable_function<void>::derived_without_cancel{
+          [gh = guarded_co_handle{h}]() mutable { gh.release().resume(); }});
+    }
   }
   void await_resume() const noexcept {}
 };
@@ -895,14 +953,22 @@ struct async_call_t {
       return false;
     }
     void await_suspend(std::coroutine_handle<> h) {
-      executor(cancellable_function<void>::derived_without_cancel{
-          [this, gh = guarded_co_handle{h}, f = std::move(f)]() mutable {
-            retval.execute([&]() -> decltype(auto) { return f(); });  // sync call
-            gh.release().resume();
-          }});
+      if constexpr (handle_scheduler<Executor>) {
+        executor.schedule(h);  // f 在 await_resume 中执行, 此时已位于 executor 的线程上
+      } else {
+        executor(cancellable_function<void>::derived_without_cancel{
+            [this, gh = guarded_co_handle{h}, f = std::move(f)]() mutable {
+              retval.execute([&]() -> decltype(auto) { return f(); });  // sync call
+              gh.release().resume();
+            }});
+      }
     }
     ret_t await_resume() {
-      return std::move(retval).get();
+      if constexpr (handle_scheduler<Executor>) {
+        return f();
+      } else {
+        return std::move(retval).get();
+      }
     }
   };
 
@@ -1162,6 +1228,65 @@ extended_awaitable<_trivial_call_awaiter<F>> lift(F&& callable) {
   return {{std::forward<F>(callable)}};
 }
 
+template <typename A>
+concept result_awaitable = is_result_v<typename co_awaitable_trait<A>::resume_t>;
+
+/**
+ * @brief 解包 result 的 awaiter
+ * * 用法: 在返回 `result<U, E>` 的协程中 `T v = co_await unwrap(task);`
+ * * 行为: task 成功时返回其值; 失败时把错误写入当前协程的返回值并直接结束当前协程,
+ * 效果等同于 `co_return fail(error);`, 全程不抛出异常.
+ * task 本身抛出异常时恢复当前协程, 并在 await_resume 中重新抛出.
+ */
+template <result_awaitable A>
+struct unwrap_awaiter {
+  using result_t = std::remove_cvref_t<typename co_awaitable_trait<A>::resume_t>;
+  using value_t = result_t::value_type;
+  using error_t = result_t::error_type;
+
+  A awaitable;
+  std::optional<result_t> value;
+  std::exception_ptr e_ptr{nullptr};
+
+  template <typename Promise>
+  co_task launch(std::coroutine_handle<Promise> h) {
+    try {
+      value.emplace(co_await std::forward<A>(awaitable));
+    } catch (...) {
+      e_ptr = std::current_exception();
+    }
+    if (e_ptr || value->has_value()) {
+      h.resume();
+    } else {
+      // 等价于 co_return fail(error); h 的协程帧 (包括本 awaiter) 在此之后可能已被销毁
+      h.promise().early_return(fail(std::move(*value).error()));
+    }
+  }
+
+  bool await_ready() const noexcept {
+    return false;
+  }
+
+  template <typename Promise>
+  void await_suspend(std::coroutine_handle<Promise> h) {
+    launch(h).detach();
+  }
+
+  value_t await_resume() {
+    if (e_ptr) {
+      std::rethrow_exception(e_ptr);
+    }
+    if constexpr (!std::is_void_v<value_t>) {
+      return std::move(*value).value();
+    }
+  }
+};
+
+template <result_awaitable A>
+unwrap_awaiter<A> unwrap(A&& awaitable) {
+  return {.awaitable = std::forward<A>(awaitable)};
+}
+
 struct all_t {
   template <co_awaitable ...T>
   struct awaiter {
@@ -1258,15 +1383,205 @@ struct all_t {
     }
   };
 
+  /**
+   * @brief 子任务均返回 result<Ui, E> 时的 all
+   * * 返回 result<std::tuple<value_storage<Ui>...>, E>; 任一子任务失败时立即恢复等待者并返回该错误,
+   * 不等待其余子任务, 也不经过异常.
+   * * 生命周期: short-circuit 后其余子任务仍在运行. 它们只访问由 shared_ptr 持有的共享状态,
+   * 以右值传入的子任务 (awaitable 本身) 也移入共享状态, 直到最后一个子任务结束才销毁;
+   * 以左值传入的子任务只保存引用, 调用方须保证它存活到所有子任务结束.
+   */
+  template <typename E, result_awaitable... T>
+  struct result_awaiter {
+    using values_t = std::tuple<value_storage<
+        typename std::remove_cvref_t<typename co_awaitable_trait<T>::resume_t>::value_type>...>;
+    using retval_t = result<values_t, E>;
+
+    struct state {
+      std::optional<std::tuple<T...>> awaiters;
+      values_t values{};
+      std::optional<E> error;
+      std::atomic<int> counter{sizeof...(T)};
+      std::atomic<bool> seized{false};
+
+      bool seize() noexcept {
+        return !seized.exchange(true, std::memory_order::acq_rel);
+      }
+    };
+
+    std::tuple<T...> awaiters;
+    std::shared_ptr<state> st = std::make_shared<state>();
+
+    template <size_t I, result_awaitable A>
+    static co_task launch_one(A&& _awaitable, std::coroutine_handle<> h,
+                              std::shared_ptr<state> st) {
+      try {
+        auto value = co_await std::forward<A>(_awaitable);
+        if (!value.has_value()) {
+          if (st->seize()) {  // short-circuit: 第一个错误直接恢复等待者
+            st->error.emplace(std::move(value).error());
+            h.resume();
+          }
+          co_return;
+        }
+        if constexpr (!std::is_void_v<typename decltype(value)::value_type>) {
+          std::get<I>(st->values).set(std::move(value).value());
+        }
+      } catch (...) {
+        std::get<I>(st->values).e_ptr = std::current_exception();
+      }
+      if (st->counter.fetch_sub(1, std::memory_order::acq_rel) == 1 && st->seize()) {
+        h.resume();
+      }
+    }
+
+    template <size_t... Is>
+    void launch(std::index_sequence<Is...> index, std::coroutine_handle<> h) {
+      auto st = this->st;  // 拷贝一份到调用栈, 最后一个子任务恢复等待者后本 awaiter 可能已被销毁
+      auto& awaiters = st->awaiters.emplace(std::move(this->awaiters));  // 从协程帧移入共享状态
+      (launch_one<Is>(
+           std::forward<std::tuple_element_t<Is, std::tuple<T...>>>(std::get<Is>(awaiters)), h, st)
+           .detach(),
+       ...);
+    }
+
+    bool await_ready() const noexcept {
+      return false;
+    }
+
+    void await_suspend(std::coroutine_handle<> h) {
+      launch(std::make_index_sequence<sizeof...(T)>(), h);
+    }
+
+    retval_t await_resume() {
+      if (st->error) {
+        return fail(std::move(*st->error));
+      }
+      return std::move(st->values);
+    }
+  };
+
+  /**
+   * @brief Range 中元素均返回 result<U, E> 时的 all, 语义 (包括生命周期) 同 result_awaiter
+   * * 以右值传入的 Range 移入共享状态; 元素为纯右值 (如 transform_view) 时按值移入子任务的协程帧
+   */
+  template <std::ranges::input_range Range>
+    requires std::ranges::sized_range<Range>
+  struct range_result_awaiter {
+    using iter_t = std::ranges::iterator_t<Range>;
+    using awaitable_t = decltype(*std::declval<iter_t>());
+    using child_t = std::remove_cvref_t<typename co_awaitable_trait<awaitable_t>::resume_t>;
+    using error_t = child_t::error_type;
+    using values_t = std::vector<value_storage<typename child_t::value_type>>;
+    using retval_t = result<values_t, error_t>;
+
+    struct state {
+      std::optional<std::tuple<Range>> awaiters;
+      values_t values;
+      std::optional<error_t> error;
+      std::atomic<int> counter;
+      std::atomic<bool> seized{false};
+
+      state(size_t n) : values(n), counter{1 + (int)n} {}
+
+      bool seize() noexcept {
+        return !seized.exchange(true, std::memory_order::acq_rel);
+      }
+    };
+
+    Range awaiters;
+    std::shared_ptr<state> st;
+
+    range_result_awaiter(Range _awaiters)
+        : awaiters{std::forward<Range>(_awaiters)},
+          st{std::make_shared<state>(std::ranges::size(awaiters))} {}
+
+    template <co_awaitable A>
+    static co_task launch_one(A _awaitable, size_t idx, std::coroutine_handle<> h,
+                              std::shared_ptr<state> st) {
+      try {
+        auto value = co_await std::forward<A>(_awaitable);
+        if (!value.has_value()) {
+          if (st->seize()) {
+            st->error.emplace(std::move(value).error());
+            h.resume();
+          }
+          co_return;
+        }
+        if constexpr (!std::is_void_v<typename child_t::value_type>) {
+          st->values[idx].set(std::move(value).value());
+        }
+      } catch (...) {
+        st->values[idx].e_ptr = std::current_exception();
+      }
+      if (st->counter.fetch_sub(1, std::memory_order::acq_rel) == 1 && st->seize()) {
+        h.resume();
+      }
+    }
+
+    bool await_ready() const noexcept {
+      return false;
+    }
+
+    void await_suspend(std::coroutine_handle<> h) {
+      auto st = this->st;  // 拷贝一份到调用栈
+      auto& awaiters = std::get<0>(st->awaiters.emplace(std::forward<Range>(this->awaiters)));
+      size_t idx = 0;
+      for (awaitable_t&& awaiter : awaiters) {
+        launch_one<awaitable_t>(std::forward<awaitable_t>(awaiter), idx++, h, st).detach();
+      }
+      if (st->counter.fetch_sub(1, std::memory_order::acq_rel) == 1 && st->seize()) {
+        h.resume();
+      }
+    }
+
+    retval_t await_resume() {
+      if (st->error) {
+        return fail(std::move(*st->error));
+      }
+      return std::move(st->values);
+    }
+  };
+
+  template <typename... T>
+  struct common_error {};
+
+  template <result_awaitable A>
+  using error_of = std::remove_cvref_t<typename co_awaitable_trait<A>::resume_t>::error_type;
+
+  template <result_awaitable T, result_awaitable... Ts>
+    requires(std::is_same_v<error_of<T>, error_of<Ts>> && ...)
+  struct common_error<T, Ts...> {
+    using type = error_of<T>;
+  };
+
+  template <typename... T>
+  static constexpr bool same_error_v = requires { typename common_error<T...>::type; };
+
   template <co_awaitable... T>
+    requires(!same_error_v<T...>)
   auto operator()(T&&... awaiters) const {
     return awaiter<T...>{.awaiters = {std::forward<T>(awaiters)...}};
   }
 
+  template <co_awaitable... T>
+    requires same_error_v<T...>
+  auto operator()(T&&... awaiters) const {
+    return result_awaiter<typename common_error<T...>::type, T...>{
+        .awaiters = {std::forward<T>(awaiters)...}};
+  }
+
   template <std::ranges::input_range Range>
+    requires(!result_awaitable<std::ranges::range_reference_t<Range>>)
   auto operator()(std::from_range_t _, Range&& awaiters) const {
     return range_awaiter<Range>{std::forward<Range>(awaiters)};
   }
+
+  template <std::ranges::input_range Range>
+    requires result_awaitable<std::ranges::range_reference_t<Range>>
+  auto operator()(std::from_range_t _, Range&& awaiters) const {
+    return range_result_awaiter<Range>{std::forward<Range>(awaiters)};
+  }
 };
 
 constexpr all_t all{};
@@ -1411,4 +1726,180 @@ struct any_t {
 
 constexpr any_t any{};
 
+/**
+ * @brief Concept: Timer 是否支持延时投递协程句柄 (customization point `schedule_after(d, handle)`)
+ */
+template <typename Timer>
+concept delay_scheduler = requires(Timer& timer, std::chrono::steady_clock::duration d,
+                                   std::coroutine_handle<> h) { timer.schedule_after(d, h); };
+
+template <delay_scheduler Timer>
+struct sleep_awaitable {
+  Timer& timer;
+  std::chrono::steady_clock::duration duration;
+
+  bool await_ready() const noexcept {
+    return duration <= std::chrono::steady_clock::duration::zero();
+  }
+  void await_suspend(std::coroutine_handle<> h) {
+    timer.schedule_after(duration, h);
+  }
+  void await_resume() const noexcept {}
+};
+
+/**
+ * @brief 异步等待 (Awaitable Helper)
+ * * 用法: `co_await async::sleep_for(timer, 10ms);`
+ * * 行为: 挂起当前协程, 由 timer 在到期后 resume (在 timer 的线程上), 不占用额外线程.
+ */
+template <delay_scheduler Timer, typename Rep, typename Period>
+sleep_awaitable<Timer> sleep_for(Timer& timer, std::chrono::duration<Rep, Period> duration) {
+  return {.timer = timer,
+          .duration = std::chrono::duration_cast<std::chrono::steady_clock::duration>(duration)};
+}
+
+/**
+ * @brief 对冲请求 (Hedged Requests)
+ * * 用法: `co_await async::hedge(factory, delay, max_copies, timer);`
+ * * 行为: 先发起一次 `factory()`; 每经过 delay 仍无成功结果, 就再发起一个副本, 至多 max_copies 个;
+ * 某个副本失败时立即补发下一个副本. 返回第一个成功的结果, 并通过 std::stop_token 请求取消其余副本;
+ * 全部失败时返回最后一个失败 (result 类型返回其错误, 否则重新抛出其异常).
+ * * 成功: 没有抛出异常, 且返回值不是 result 类型或 `has_value()`.
+ * * factory 可接受一个 std::stop_token 参数, 用于感知取消; factory 可能在 timer 的线程上被调用.
+ */
+struct hedge_t {
+  template <typename F>
+  struct factory_trait {
+    using awaitable_t = std::invoke_result_t<F&>;
+  };
+
+  template <std::invocable<std::stop_token> F>
+  struct factory_trait<F> {
+    using awaitable_t = std::invoke_result_t<F&, std::stop_token>;
+  };
+
+  template <typename F, delay_scheduler Timer>
+  struct awaiter {
+    using awaitable_t = factory_trait<F>::awaitable_t;
+    using retval_t = co_awaitable_trait<awaitable_t>::resume_t;
+
+    struct state {
+      F factory;
+      int max_copies;
+      std::stop_source stop;
+      std::atomic<int> launched{0};
+      std::atomic<int> failed{0};
+      std::atomic<bool> seized{false};
+      value_storage<retval_t> value;
+      std::coroutine_handle<> h;
+
+      bool seize() noexcept {
+        return !seized.exchange(true, std::memory_order::acq_rel);
+      }
+
+      decltype(auto) make() {
+        if constexpr (std::invocable<F&, std::stop_token>) {
+          return factory(stop.get_token());
+        } else {
+          return factory();
+        }
+      }
+    };
+
+    std::shared_ptr<state> st;
+    Timer& timer;
+    std::chrono::steady_clock::duration delay;
+
+    static bool succeeded(value_storage<retval_t>& value) {
+      if (value.e_ptr) {
+        return false;
+      }
+      if constexpr (is_result_v<retval_t>) {
+        return value.get().has_value();
+      } else {
+        return true;
+      }
+    }
+
+    static void launch_next(const std::shared_ptr<state>& st) {
+      if (st->launched.fetch_add(1, std::memory_order::acq_rel) < st->max_copies) {
+        attempt(st).detach();
+      }
+    }
+
+    static co_task attempt(std::shared_ptr<state> st) {
+      value_storage<retval_t> value;
+      try {
+        if constexpr (std::is_void_v<retval_t>) {
+          co_await st->make();
+        } else {
+          value.set(co_await st->make());
+        }
+      } catch (...) {
+        value.e_ptr = std::current_exception();
+      }
+      if (succeeded(value)) {
+        if (st->seize()) {
+          st->value = std::move(value);  // result is valid before (the only one) resume
+          st->stop.request_stop();
+          st->h.resume();
+        }
+        co_return;
+      }
+      if (st->failed.fetch_add(1, std::memory_order::acq_rel) + 1 == st->max_copies) {
+        if (st->seize()) {  // 全部失败, 返回最后一个失败
+          st->value = std::move(value);
+          st->h.resume();
+        }
+        co_return;
+      }
+      launch_next(st);  // 失败时立即补发
+    }
+
+    static co_task backup(std::shared_ptr<state> st, Timer& timer,
+                          std::chrono::steady_clock::duration delay) {
+      while (!st->seized.load(std::memory_order::acquire) &&
+             st->launched.load(std::memory_order::acquire) < st->max_copies) {
+        co_await sleep_for(timer, delay);
+        if (st->seized.load(std::memory_order::acquire)) {
+          break;
+        }
+        launch_next(st);
+      }
+    }
+
+    bool await_ready() const noexcept {
+      return false;
+    }
+
+    void await_suspend(std::coroutine_handle<> h) {
+      auto st = this->st;  // 拷贝一份到调用栈, 第一个副本可能同步完成并 resume h
+      auto& timer = this->timer;
+      auto delay = this->delay;
+      st->h = h;
+      launch_next(st);
+      backup(std::move(st), timer, delay).detach();
+    }
+
+    retval_t await_resume() {
+      return std::move(st->value).get();
+    }
+  };
+
+  template <typename F, typename Rep, typename Period, delay_scheduler Timer>
+    requires std::invocable<F&> || std::invocable<F&, std::stop_token>
+  auto operator()(F factory, std::chrono::duration<Rep, Period> delay, int max_copies,
+                  Timer& timer) const {
+    using awaiter_t = awaiter<F, Timer>;
+    using duration_t = std::chrono::steady_clock::duration;
+    auto st =
+        std::make_shared<typename awaiter_t::state>(std::move(factory), std::max(1, max_copies));
+    return awaiter_t{.st = std::move(st),
+                     .timer = timer,
+                     .delay = std::chrono::duration_cast<duration_t>(delay)};
+  }
+};
+
+constexpr hedge_t hedge{};
+
 };  // namespace async
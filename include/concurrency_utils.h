@@ -1,18 +1,34 @@
 #pragma once
 
+#include <algorithm>
+#include <array>
 #include <atomic>
 #include <chrono>
 #include <concepts>
 #include <condition_variable>
+#include <coroutine>
+#include <cstdint>
 #include <deque>
+#include <functional>
+#include <memory_resource>
 #include <mutex>
+#include <queue>
+#include <ranges>
 #include <semaphore>
 #include <stop_token>
 #include <thread>
 #include <type_traits>
 #include <utility>
+#include <variant>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+#include <time.h>
 
 #include "async_tool.h"
+#include "message.h"
 #include "toyqueue.h"
 
 namespace playground {
@@ -104,6 +120,180 @@ struct default_timestamp_generator {
   }
 };
 
+/**
+ * @brief TSGen 若声明 `static constexpr bool thread_safe = true`, sync_stream 在加锁前生成时间戳
+ * @note 此时多写入方之间时间戳与序列号的先后可能有微小的不一致
+ */
+template <typename TSGen>
+concept thread_safe_timestamp_generator = requires {
+  requires TSGen::thread_safe;
+};
+
+/**
+ * @brief CLOCK_MONOTONIC_COARSE (vDSO, 精度约为一个 tick, 通常 1~4ms), 首次调用时与 system_clock 对齐
+ * * 非 Linux 平台退化为 system_clock::now()
+ */
+struct coarse_timestamp_generator {
+  using time_point_t = std::chrono::time_point<std::chrono::system_clock>;
+  static constexpr bool thread_safe = true;
+
+  time_point_t operator()() noexcept {
+#if defined(__linux__) && defined(CLOCK_MONOTONIC_COARSE)
+    static const auto offset = std::chrono::system_clock::now().time_since_epoch() - now_coarse();
+    return time_point_t{std::chrono::duration_cast<time_point_t::duration>(now_coarse() + offset)};
+#else
+    return std::chrono::system_clock::now();
+#endif
+  }
+
+ private:
+#if defined(__linux__) && defined(CLOCK_MONOTONIC_COARSE)
+  static std::chrono::nanoseconds now_coarse() noexcept {
+    timespec ts{};
+    clock_gettime(CLOCK_MONOTONIC_COARSE, &ts);
+    return std::chrono::seconds{ts.tv_sec} + std::chrono::nanoseconds{ts.tv_nsec};
+  }
+#endif
+};
+
+/**
+ * @brief 基于 rdtsc 的时钟: 首次调用时用 steady_clock 校准约 10ms 得到 tick 周期, 之后每次只读 TSC
+ * * 要求 invariant TSC (现代 x86 普遍满足); 长时间运行会与 system_clock 产生漂移
+ * * 非 x86 平台退化为 system_clock::now()
+ */
+struct tsc_timestamp_generator {
+  using time_point_t = std::chrono::time_point<std::chrono::system_clock>;
+  static constexpr bool thread_safe = true;
+
+  time_point_t operator()() noexcept {
+#if defined(__x86_64__) || defined(__i386__)
+    static const calibration cal = calibrate();
+    const auto ticks = static_cast<double>(__rdtsc() - cal.tsc);
+    const std::chrono::nanoseconds ns{static_cast<int64_t>(ticks * cal.ns_per_tick)};
+    return cal.base + std::chrono::duration_cast<time_point_t::duration>(ns);
+#else
+    return std::chrono::system_clock::now();
+#endif
+  }
+
+ private:
+#if defined(__x86_64__) || defined(__i386__)
+  struct calibration {
+    uint64_t tsc;
+    time_point_t base;
+    double ns_per_tick;
+  };
+
+  static calibration calibrate() noexcept {
+    using namespace std::chrono_literals;
+    const auto steady_begin = std::chrono::steady_clock::now();
+    const uint64_t tsc_begin = __rdtsc();
+    const auto base = std::chrono::system_clock::now();
+    while (std::chrono::steady_clock::now() - steady_begin < 10ms) {
+    }
+    const auto elapsed = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() -
+                                                                  steady_begin);
+    const uint64_t tsc_end = __rdtsc();
+    return {.tsc = tsc_begin,
+            .base = base,
+            .ns_per_tick = elapsed.count() / static_cast<double>(tsc_end - tsc_begin)};
+  }
+#endif
+};
+
+/**
+ * @brief 后台线程每 resolution 刷新一次的缓存时钟, 读取只是一次 relaxed 原子读
+ * * 精度为 resolution; 析构时停止后台线程
+ */
+class clock_ticker {
+  std::atomic<int64_t> now_ns;
+  std::chrono::steady_clock::duration resolution;
+  std::mutex mutex;
+  stoppable_cv cv;
+  guarded_thread th;
+
+  static int64_t system_now() noexcept {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::system_clock::now().time_since_epoch())
+        .count();
+  }
+
+  void run() {
+    std::unique_lock lock{mutex};
+    while (!cv->wait_for(lock, resolution, [this]() { return cv.is_stopped(); })) {
+      now_ns.store(system_now(), std::memory_order_relaxed);
+    }
+  }
+
+ public:
+  using time_point_t = std::chrono::time_point<std::chrono::system_clock>;
+
+  explicit clock_ticker(
+      std::chrono::steady_clock::duration resolution = std::chrono::milliseconds{1})
+      : now_ns{system_now()}, resolution{resolution}, th{std::thread{[this]() { run(); }}} {}
+
+  ~clock_ticker() {
+    {
+      std::lock_guard lock{mutex};
+      cv.stop();
+    }
+  }
+
+  time_point_t now() const noexcept {
+    return time_point_t{std::chrono::duration_cast<time_point_t::duration>(
+        std::chrono::nanoseconds{now_ns.load(std::memory_order_relaxed)})};
+  }
+
+  static clock_ticker& global() {
+    static clock_ticker ticker{};
+    return ticker;
+  }
+};
+
+/**
+ * @brief 读取全局 clock_ticker 的缓存时钟 (精度 1ms), 首次调用时启动后台线程
+ */
+struct cached_timestamp_generator {
+  using time_point_t = clock_ticker::time_point_t;
+  static constexpr bool thread_safe = true;
+
+  time_point_t operator()() noexcept {
+    thread_local clock_ticker* ticker = &clock_ticker::global();
+    return ticker->now();
+  }
+};
+
+/**
+ * @brief 32 位序列号, 配合 msg::compact_message 使用
+ */
+struct compact_id_generator {
+  uint32_t current_id{};
+  uint32_t operator()() noexcept {
+    return ++current_id;
+  }
+};
+
+/**
+ * @brief 为 msg::compact_message 生成相对于 epoch 的 32 位时间戳
+ * * epoch 在生成器构造时由 Base 取得; 生成器是 stream 的成员, 因此每个 stream 有自己的 epoch.
+ * * Base 可以是上面任一时钟 (如 cached_timestamp_generator), 线程安全性随 Base.
+ */
+template <typename Tick = std::chrono::microseconds,
+          std::invocable Base = default_timestamp_generator>
+struct epoch_timestamp_generator {
+  using time_point_t = std::invoke_result_t<Base&>;
+  static constexpr bool thread_safe = thread_safe_timestamp_generator<Base>;
+
+  Base base{};
+  const time_point_t epoch{base()};
+
+  msg::compact_timestamp<Tick> operator()() noexcept {
+    const auto ticks =
+        static_cast<uint32_t>(std::chrono::duration_cast<Tick>(base() - epoch).count());
+    return {ticks == msg::compact_timestamp<Tick>::none ? ticks - 1 : ticks};
+  }
+};
+
 enum class sync_stream_read_write_status : std::uint8_t { empty, good };
 
 template <std::movable T, std::invocable IDGen = default_id_generator,
@@ -117,20 +307,33 @@ class sync_stream {
   TSGen ts_gen{};
   std::mutex mutex;
   stoppable_cv cv;
-  std::deque<T> queue;
+  std::pmr::deque<T> queue;
 
  public:
   using msg_t = T;
   using status = sync_stream_read_write_status;  // template params independent
 
+  sync_stream() = default;
+
+  /**
+   * @param resource 队列节点与 write_many 临时缓冲的内存来源; 取出的批次在锁外释放,
+   *                 因此须是线程安全的 (如 std::pmr::synchronized_pool_resource)
+   */
+  explicit sync_stream(std::pmr::memory_resource* resource) : queue{resource} {}
+
   template <typename U>
     requires requires(U&& data) { msg_t{std::forward<U>(data)}; }
   status write_sync(U&& data) {
     msg_t msg{std::forward<U>(data)};
+    if constexpr (thread_safe_timestamp_generator<TSGen>) {
+      msg.timestamp = ts_gen();
+    }
     {
       std::lock_guard lock{mutex};
       msg.serial_number = id_gen();
-      msg.timestamp = ts_gen();
+      if constexpr (!thread_safe_timestamp_generator<TSGen>) {
+        msg.timestamp = ts_gen();
+      }
       queue.push_back(std::move(msg));
     }
     cv->notify_one();
@@ -147,6 +350,90 @@ class sync_stream {
     return status::empty;
   }
 
+  /**
+   * @brief 批量写入: 消息在锁外构造, 一次加锁分配连续的序列号, 最后只 notify 一次
+   * @return 写入的消息数
+   */
+  template <std::ranges::input_range R>
+    requires requires(std::ranges::range_reference_t<R> data) {
+      msg_t{std::forward<decltype(data)>(data)};
+    }
+  size_t write_many(R&& range) {
+    std::pmr::vector<msg_t> msgs{queue.get_allocator()};
+    if constexpr (std::ranges::sized_range<R>) {
+      msgs.reserve(std::ranges::size(range));
+    }
+    for (auto&& data : range) {
+      msgs.push_back(msg_t{std::forward<decltype(data)>(data)});
+      if constexpr (thread_safe_timestamp_generator<TSGen>) {
+        msgs.back().timestamp = ts_gen();
+      }
+    }
+    if (msgs.empty()) {
+      return 0;
+    }
+    {
+      std::lock_guard lock{mutex};
+      for (auto& msg : msgs) {
+        msg.serial_number = id_gen();
+        if constexpr (!thread_safe_timestamp_generator<TSGen>) {
+          msg.timestamp = ts_gen();
+        }
+        queue.push_back(std::move(msg));
+      }
+    }
+    if (msgs.size() == 1) {
+      cv->notify_one();
+    } else {
+      cv->notify_all();
+    }
+    return msgs.size();
+  }
+
+  /**
+   * @brief 批量读取: 与 read_sync 一样阻塞到有消息或 stop, 之后一次取出至多 max 条消息
+   * @return 读出的消息数, 0 表示 stream 已停止且为空; max 为 0 时不阻塞, 直接返回 0
+   */
+  template <std::output_iterator<T&&> Out>
+  size_t read_many(Out output, size_t max) {
+    if (max == 0) {
+      return 0;
+    }
+    std::unique_lock lock{mutex};
+    cv->wait(lock, [this]() { return !queue.empty() || cv.is_stopped(); });
+    return take(lock, output, max);
+  }
+
+  /**
+   * @brief read_many 的非阻塞版本, 没有消息 (或 max 为 0) 时立即返回 0
+   */
+  template <std::output_iterator<T&&> Out>
+  size_t try_read_many(Out output, size_t max) {
+    if (max == 0) {
+      return 0;
+    }
+    std::unique_lock lock{mutex};
+    return take(lock, output, max);
+  }
+
+  /**
+   * @brief 取出当前所有消息并在锁外逐条调用 callback(T&&), 阻塞语义同 read_sync
+   * @return 处理的消息数, 0 表示 stream 已停止且为空
+   */
+  template <std::invocable<T&&> F>
+  size_t drain(F&& callback) {
+    std::pmr::deque<T> batch{queue.get_allocator()};
+    {
+      std::unique_lock lock{mutex};
+      cv->wait(lock, [this]() { return !queue.empty() || cv.is_stopped(); });
+      batch.swap(queue);
+    }
+    for (auto& msg : batch) {
+      std::invoke(callback, std::move(msg));
+    }
+    return batch.size();
+  }
+
   template <typename U>
     requires requires(U&& data) { msg_t{std::forward<U>(data)}; }
   status operator<<(U&& data) {
@@ -171,6 +458,27 @@ class sync_stream {
   }
 
  private:
+  /**
+   * @brief 取出至多 max 条消息; 能一次取空时交换整个队列, 在锁外移出元素
+   */
+  template <typename Out>
+  size_t take(std::unique_lock<std::mutex>& lock, Out& output, size_t max) {
+    if (queue.size() > max) {
+      for (size_t i = 0; i < max; i++) {
+        *output++ = std::move(queue.front());
+        queue.pop_front();
+      }
+      return max;
+    }
+    std::pmr::deque<T> batch{queue.get_allocator()};
+    batch.swap(queue);  // O(1)
+    lock.unlock();
+    for (auto& msg : batch) {
+      *output++ = std::move(msg);
+    }
+    return batch.size();
+  }
+
   void get_front(T& data) {
     if constexpr (std::is_nothrow_move_assignable_v<T>) {  // move assign
       data = std::move(queue.front());
@@ -190,16 +498,324 @@ class sync_stream {
   }
 };
 
+/**
+ * @brief 使用紧凑表头 (msg::compact_message) 的 sync_stream
+ */
+template <msg::valid_msg_variant V, typename Tick = std::chrono::microseconds,
+          std::invocable Base = default_timestamp_generator>
+using compact_sync_stream = sync_stream<msg::compact_message<V, Tick>, compact_id_generator,
+                                        epoch_timestamp_generator<Tick, Base>>;
+
+/**
+ * @brief 按消息类型分区的 sync_stream: 每个 variant 分支一个队列和一个条件变量
+ * * `read_sync<sum_msg>(out)` 只在 sum_msg 分区上等待, 其他类型的写入不会唤醒它;
+ * `read_sync(out)` 是合并读取, 按序列号顺序取出所有分区的消息.
+ * * 写入分支在编译期由 msg::index_of 确定 (写入整条 message / variant 时退化为运行期 index());
+ * 所有分区共享一把锁, 序列号在锁内分配, 因此每个分区内部有序, 合并读取只需比较各分区队首.
+ */
+template <std::movable T, std::invocable IDGen = default_id_generator,
+          std::invocable TSGen = default_timestamp_generator>
+  requires msg::some_variant<typename T::variant_t> && requires(T t) {
+    t.serial_number = std::declval<IDGen>()();
+    t.timestamp = std::declval<TSGen>()();
+  } && std::is_default_constructible_v<IDGen> && std::is_default_constructible_v<TSGen>
+class partitioned_sync_stream {
+ public:
+  using msg_t = T;
+  using variant_t = typename T::variant_t;
+  using status = sync_stream_read_write_status;  // template params independent
+
+ private:
+  static constexpr size_t partitions = std::variant_size_v<variant_t>;
+
+  struct partition {
+    std::deque<T> queue;
+    std::condition_variable cv;
+  };
+
+  IDGen id_gen{};
+  TSGen ts_gen{};
+  std::mutex mutex;
+  std::array<partition, partitions> parts;
+  std::condition_variable merged_cv;
+  std::atomic<size_t> size{0};
+  std::atomic<bool> stopped{false};
+
+  template <typename U>
+  static constexpr size_t static_index =
+      msg::type_in_variant_<std::remove_cvref_t<U>, variant_t>::index;
+
+  template <typename U>
+  status write(U&& data) {
+    msg_t msg{std::forward<U>(data)};
+    size_t index{};
+    if constexpr (static_index<U> != msg::index_not_found) {
+      index = static_index<U>;
+    } else {
+      index = static_cast<variant_t&>(msg).index();
+    }
+    if constexpr (thread_safe_timestamp_generator<TSGen>) {
+      msg.timestamp = ts_gen();
+    }
+    {
+      std::lock_guard lock{mutex};
+      msg.serial_number = id_gen();
+      if constexpr (!thread_safe_timestamp_generator<TSGen>) {
+        msg.timestamp = ts_gen();
+      }
+      parts[index].queue.push_back(std::move(msg));
+      size.fetch_add(1, std::memory_order_relaxed);
+    }
+    parts[index].cv.notify_one();
+    merged_cv.notify_one();
+    return status::good;
+  }
+
+  static void pop_front(std::deque<T>& queue, T& data) {
+    data = std::move(queue.front());
+    queue.pop_front();
+  }
+
+ public:
+  template <typename U>
+    requires requires(U&& data) { msg_t{std::forward<U>(data)}; }
+  status write_sync(U&& data) {
+    return write(std::forward<U>(data));
+  }
+
+  /**
+   * @brief 只读取 A 类型的消息, 阻塞到该分区有消息或 stop
+   */
+  template <msg::type_in_variant<variant_t> A>
+  status read_sync(T& data) {
+    constexpr size_t index = static_index<A>;
+    auto& part = parts[index];
+    std::unique_lock lock{mutex};
+    part.cv.wait(lock, [&]() { return !part.queue.empty() || stopped.load(); });
+    if (part.queue.empty()) {
+      return status::empty;
+    }
+    pop_front(part.queue, data);
+    size.fetch_sub(1, std::memory_order_relaxed);
+    return status::good;
+  }
+
+  /**
+   * @brief 合并读取: 取出所有分区中序列号最小的消息
+   */
+  status read_sync(T& data) {
+    std::unique_lock lock{mutex};
+    merged_cv.wait(lock, [this]() { return size.load() != 0 || stopped.load(); });
+    partition* first = nullptr;
+    for (auto& part : parts) {
+      if (part.queue.empty()) {
+        continue;
+      }
+      if (first == nullptr ||
+          part.queue.front().serial_number < first->queue.front().serial_number) {
+        first = &part;
+      }
+    }
+    if (first == nullptr) {
+      return status::empty;
+    }
+    pop_front(first->queue, data);
+    size.fetch_sub(1, std::memory_order_relaxed);
+    return status::good;
+  }
+
+  template <typename U>
+    requires requires(U&& data) { msg_t{std::forward<U>(data)}; }
+  status operator<<(U&& data) {
+    return write_sync(std::forward<U>(data));
+  }
+
+  status operator>>(T& data) {
+    return read_sync(data);
+  }
+
+  operator bool() const noexcept {
+    return size.load() != 0 || !stopped.load();
+  }
+
+  /**
+   * @brief 分区版本的 operator bool: A 分区非空或 stream 未停止
+   */
+  template <msg::type_in_variant<variant_t> A>
+  bool active() {
+    std::lock_guard lock{mutex};
+    return !parts[static_index<A>].queue.empty() || !stopped.load();
+  }
+
+  void stop() {
+    {
+      std::lock_guard lock{mutex};
+      stopped = true;
+    }
+    for (auto& part : parts) {
+      part.cv.notify_all();
+    }
+    merged_cv.notify_all();
+  }
+
+  template <typename Op, typename Executor>
+  auto get_dispatcher(Op op, Executor&& executor) {
+    return async::make_dispatcher<msg_t, Op>(*this, std::forward<Executor>(executor));
+  }
+};
+
+/**
+ * @brief eventcount: 无锁数据结构上的条件等待
+ * * 消费者: `key = prepare_wait()` -> 重新检查条件 -> 条件满足则 `cancel_wait()`, 否则 `wait(key)`;
+ * 生产者: 修改数据后 `notify_one()` / `notify_all()`. 没有等待者时 notify 只有一次原子读.
+ */
+class eventcount {
+  std::atomic<uint32_t> epoch{0};
+  std::atomic<uint32_t> waiters{0};
+
+ public:
+  using key_t = uint32_t;
+
+  key_t prepare_wait() noexcept {
+    waiters.fetch_add(1, std::memory_order_seq_cst);
+    std::atomic_thread_fence(std::memory_order_seq_cst);  // 与 notify 中的 fence 配对
+    return epoch.load(std::memory_order_acquire);
+  }
+
+  void cancel_wait() noexcept {
+    waiters.fetch_sub(1, std::memory_order_relaxed);
+  }
+
+  void wait(key_t key) noexcept {
+    epoch.wait(key, std::memory_order_acquire);
+    waiters.fetch_sub(1, std::memory_order_relaxed);
+  }
+
+  void notify_one() noexcept {
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (waiters.load(std::memory_order_relaxed) != 0) {
+      epoch.fetch_add(1, std::memory_order_release);
+      epoch.notify_one();
+    }
+  }
+
+  void notify_all() noexcept {
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (waiters.load(std::memory_order_relaxed) != 0) {
+      epoch.fetch_add(1, std::memory_order_release);
+      epoch.notify_all();
+    }
+  }
+};
+
+/**
+ * @brief sync_stream 的无锁版本, 接口相同 (`<<`, `>>`, `stop()`, `get_dispatcher`)
+ * * 写入: 序列号由原子计数器分配, 时间戳在锁外生成, 通过 toyqueue::fix_cap_queue 发布;
+ * * 读取: 队列非空时直接 pop; 为空时短暂自旋, 之后才在 eventcount 上挂起.
+ * @note 容量固定为 2^log_cap, 队列满时写入方自旋等待;
+ *       多个写入方并发时, 出队顺序与序列号顺序可能有局部的不一致;
+ *       TSGen 会被多个线程并发调用, 必须是线程安全的.
+ */
+template <std::movable T, std::invocable TSGen = default_timestamp_generator>
+  requires requires(T t) {
+    t.serial_number = size_t{};
+    t.timestamp = std::declval<TSGen>()();
+  } && std::is_default_constructible_v<TSGen>
+class lockfree_sync_stream {
+  static constexpr int spin_count = 64;
+
+  TSGen ts_gen{};
+  std::atomic<size_t> current_id{0};
+  std::atomic<bool> stopped{false};
+  toyqueue::fix_cap_queue<T> queue;
+  eventcount ec;
+
+  bool try_read(T& data) {
+    auto front = queue.try_pop();
+    if (front.has_value()) {
+      data = std::move(front.value());
+      return true;
+    }
+    return false;
+  }
+
+ public:
+  using msg_t = T;
+  using status = sync_stream_read_write_status;  // template params independent
+
+  lockfree_sync_stream(size_t log_cap = 16) : queue{log_cap} {}
+
+  template <typename U>
+    requires requires(U&& data) { msg_t{std::forward<U>(data)}; }
+  status write_sync(U&& data) {
+    msg_t msg{std::forward<U>(data)};
+    msg.serial_number = current_id.fetch_add(1, std::memory_order_relaxed) + 1;
+    msg.timestamp = ts_gen();
+    while (!queue.try_push(std::move(msg))) {
+      std::this_thread::yield();
+    }
+    ec.notify_one();
+    return status::good;
+  }
+
+  status read_sync(T& data) {
+    while (true) {
+      for (int i = 0; i < spin_count; i++) {
+        if (try_read(data)) {
+          return status::good;
+        }
+        if (stopped.load(std::memory_order_acquire)) {
+          return try_read(data) ? status::good : status::empty;
+        }
+      }
+      auto key = ec.prepare_wait();
+      if (!queue.empty() || stopped.load(std::memory_order_acquire)) {
+        ec.cancel_wait();
+        continue;
+      }
+      ec.wait(key);
+    }
+  }
+
+  template <typename U>
+    requires requires(U&& data) { msg_t{std::forward<U>(data)}; }
+  status operator<<(U&& data) {
+    return write_sync(std::forward<U>(data));
+  }
+
+  status operator>>(T& data) {
+    return read_sync(data);
+  }
+
+  operator bool() const noexcept {
+    return !queue.empty() || !stopped.load(std::memory_order_acquire);
+  }
+
+  void stop() {
+    stopped.store(true, std::memory_order_release);
+    ec.notify_all();
+  }
+
+  template <typename Op, typename Executor>
+  auto get_dispatcher(Op op, Executor&& executor) {
+    return async::make_dispatcher<msg_t, Op>(*this, std::forward<Executor>(executor));
+  }
+};
+
+/**
+ * @brief 执行器: 一个 fix_cap_queue 任务队列 + threads 条工作线程 (默认 1 条)
+ * * 多条线程时任务按入队顺序被各线程取走 (近似 FIFO), 可作为线程池使用.
+ */
 template <std::movable F>
 class runner {
   toyqueue::fix_cap_queue<F> queue;
   std::stop_source stop_source;
   std::counting_semaphore<> semaphore{0};
-  guarded_thread th;
+  std::vector<guarded_thread> ths;
 
   void stop() {
     stop_source.request_stop();
-    semaphore.release();
+    semaphore.release((std::ptrdiff_t)ths.size());
   }
 
   void drain() {
@@ -210,6 +826,14 @@ class runner {
           task.value().cancel();
         }
       }
+    } else if constexpr (std::is_same_v<F, std::coroutine_handle<>>) {
+      // 与 guarded_co_handle 的析构行为一致: 未被 resume 的协程在 drain 时 destroy
+      while (!queue.empty()) {
+        auto h = queue.try_pop();
+        if (h.has_value() && h.value()) {
+          h.value().destroy();
+        }
+      }
     } else {
     }
   }
@@ -230,7 +854,16 @@ class runner {
   }
 
  public:
-  runner(size_t log_cap = 16) : queue{log_cap}, th{std::thread{[this]() { run(); }}} {}
+  runner(size_t log_cap = 16, size_t threads = 1) : queue{log_cap} {
+    ths.reserve(threads);
+    for (size_t i = 0; i < std::max<size_t>(threads, 1); i++) {
+      ths.emplace_back(std::thread{[this]() { run(); }});
+    }
+  }
+
+  size_t concurrency() const noexcept {
+    return ths.size();
+  }
 
   ~runner() {
     stop();
@@ -244,6 +877,103 @@ class runner {
     }
     semaphore.release();
   }
+
+  /**
+   * @brief handle-native 模式 (`runner<std::coroutine_handle<>>`) 的投递入口
+   * * execute_by / async_call 等检测到 schedule 后直接投递 8 字节的协程句柄,
+   * 不再构造 cancellable_function (堆分配 + 虚函数调用).
+   */
+  void schedule(std::coroutine_handle<> h)
+    requires std::is_same_v<F, std::coroutine_handle<>>
+  {
+    (*this)(h);
+  }
+};
+
+/**
+ * @brief 队列元素为裸协程句柄的 runner, 仅用于 resume 协程; stop 时 destroy 未执行的协程.
+ */
+using handle_runner = runner<std::coroutine_handle<>>;
+
+/**
+ * @brief 单线程定时器: 按到期时间 resume 协程 (满足 async::delay_scheduler)
+ * * 所有定时共享一条线程与一个最小堆, 不为每个定时器创建线程; 协程在定时器线程上被 resume,
+ * 耗时工作应通过 execute_by 切换到其他执行器. stop 时 destroy 尚未到期的协程.
+ */
+class timer_runner {
+ public:
+  using clock_t = std::chrono::steady_clock;
+
+ private:
+  struct entry {
+    clock_t::time_point deadline;
+    std::coroutine_handle<> h;
+
+    bool operator>(const entry& other) const noexcept {
+      return deadline > other.deadline;
+    }
+  };
+
+  std::priority_queue<entry, std::vector<entry>, std::greater<>> queue;
+  std::mutex mutex;
+  stoppable_cv cv;
+  guarded_thread th;
+
+  void stop() {
+    {
+      std::lock_guard lock{mutex};
+      cv.stop();
+    }
+  }
+
+  void drain() {
+    while (!queue.empty()) {
+      queue.top().h.destroy();
+      queue.pop();
+    }
+  }
+
+  void run() {
+    std::unique_lock lock{mutex};
+    while (true) {
+      cv->wait(lock, [this]() { return !queue.empty() || cv.is_stopped(); });
+      if (cv.is_stopped()) {
+        drain();
+        return;
+      }
+      const auto deadline = queue.top().deadline;
+      // 被唤醒时若出现了更早的到期时间或 stop, 重新判断
+      if (cv->wait_until(lock, deadline, [&]() {
+            return cv.is_stopped() || queue.top().deadline < deadline;
+          })) {
+        continue;
+      }
+      auto h = queue.top().h;
+      queue.pop();
+      lock.unlock();
+      h.resume();
+      lock.lock();
+    }
+  }
+
+ public:
+  timer_runner() : th{std::thread{[this]() { run(); }}} {}
+
+  ~timer_runner() {
+    stop();
+  }
+
+  void schedule_at(clock_t::time_point deadline, std::coroutine_handle<> h) {
+    {
+      std::lock_guard lock{mutex};
+      queue.push(entry{.deadline = deadline, .h = h});
+    }
+    cv->notify_one();
+  }
+
+  void schedule_after(clock_t::duration duration, std::coroutine_handle<> h) {
+    schedule_at(clock_t::now() + duration, h);
+  }
 };
 
 }  // namespace playground
@@ -0,0 +1,549 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <concepts>
+#include <cstddef>
+#include <cstring>
+#include <iterator>
+#include <memory>
+#include <new>
+#include <ostream>
+#include <span>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <version>
+
+#if defined(__cpp_lib_mdspan)
+#include <mdspan>
+#endif
+
+namespace playground {
+
+/**
+ * @brief 行首对齐到 cache line, 同时也满足 AVX-512 load/store 的对齐要求
+ */
+constexpr size_t matrix_alignment = 64;
+
+/**
+ * @brief 等间隔的一维视图, 例如矩阵的一列 (stride = 行跨度)
+ */
+template <typename T>
+class strided_span {
+ public:
+  using element_type = T;
+  using value_type = std::remove_cv_t<T>;
+
+  class iterator {
+   public:
+    using iterator_concept = std::random_access_iterator_tag;
+    using iterator_category = std::random_access_iterator_tag;
+    using value_type = std::remove_cv_t<T>;
+    using difference_type = std::ptrdiff_t;
+    using reference = T&;
+
+    iterator() = default;
+    iterator(T* ptr, std::ptrdiff_t stride) : ptr{ptr}, stride{stride} {}
+
+    T& operator*() const {
+      return *ptr;
+    }
+    T& operator[](difference_type n) const {
+      return ptr[n * stride];
+    }
+    iterator& operator++() {
+      ptr += stride;
+      return *this;
+    }
+    iterator operator++(int) {
+      auto old = *this;
+      ptr += stride;
+      return old;
+    }
+    iterator& operator--() {
+      ptr -= stride;
+      return *this;
+    }
+    iterator operator--(int) {
+      auto old = *this;
+      ptr -= stride;
+      return old;
+    }
+    iterator& operator+=(difference_type n) {
+      ptr += n * stride;
+      return *this;
+    }
+    iterator& operator-=(difference_type n) {
+      ptr -= n * stride;
+      return *this;
+    }
+    friend iterator operator+(iterator it, difference_type n) {
+      return it += n;
+    }
+    friend iterator operator+(difference_type n, iterator it) {
+      return it += n;
+    }
+    friend iterator operator-(iterator it, difference_type n) {
+      return it -= n;
+    }
+    friend difference_type operator-(const iterator& a, const iterator& b) {
+      return a.stride == 0 ? 0 : (a.ptr - b.ptr) / a.stride;
+    }
+    friend bool operator==(const iterator& a, const iterator& b) {
+      return a.ptr == b.ptr;
+    }
+    friend auto operator<=>(const iterator& a, const iterator& b) {
+      return a.stride < 0 ? b.ptr <=> a.ptr : a.ptr <=> b.ptr;
+    }
+
+   private:
+    T* ptr{};
+    std::ptrdiff_t stride{};
+  };
+
+  strided_span() = default;
+  strided_span(T* data, size_t size, std::ptrdiff_t stride) : ptr{data}, count{size}, step{stride} {}
+
+  T& operator[](size_t i) const {
+    return ptr[(std::ptrdiff_t)i * step];
+  }
+  size_t size() const noexcept {
+    return count;
+  }
+  bool empty() const noexcept {
+    return count == 0;
+  }
+  std::ptrdiff_t stride() const noexcept {
+    return step;
+  }
+  T* data() const noexcept {
+    return ptr;
+  }
+  iterator begin() const {
+    return {ptr, step};
+  }
+  iterator end() const {
+    return {ptr + (std::ptrdiff_t)count * step, step};
+  }
+
+ private:
+  T* ptr{};
+  size_t count{};
+  std::ptrdiff_t step{};
+};
+
+/**
+ * @brief 行主序、带行跨度的二维视图, 不拥有内存
+ * * 元素 (r, c) 位于 `data()[r * stride() + c]`; `row(r)` 是连续的 std::span,
+ * `col(c)` 是 strided_span, `block(r, c, h, w)` 是共享同一块内存的子矩阵.
+ * * matrix_view<T> 可以隐式转换为 matrix_view<const T>.
+ */
+template <typename T>
+class matrix_view {
+ public:
+  using element_type = T;
+  using value_type = std::remove_cv_t<T>;
+
+  matrix_view() = default;
+  matrix_view(T* data, size_t rows, size_t cols, size_t stride)
+      : ptr{data}, n_rows{rows}, n_cols{cols}, row_stride{stride} {}
+  matrix_view(T* data, size_t rows, size_t cols) : matrix_view{data, rows, cols, cols} {}
+
+  template <typename U>
+    requires std::is_convertible_v<U (*)[], T (*)[]>
+  matrix_view(const matrix_view<U>& other)
+      : matrix_view{other.data(), other.rows(), other.cols(), other.stride()} {}
+
+  size_t rows() const noexcept {
+    return n_rows;
+  }
+  size_t cols() const noexcept {
+    return n_cols;
+  }
+  size_t stride() const noexcept {
+    return row_stride;
+  }
+  T* data() const noexcept {
+    return ptr;
+  }
+  bool empty() const noexcept {
+    return n_rows == 0 || n_cols == 0;
+  }
+  /**
+   * @brief 各行之间没有空隙, 整块内存可以当作一维数组处理
+   */
+  bool contiguous() const noexcept {
+    return n_rows <= 1 || row_stride == n_cols;
+  }
+
+  /**
+   * @brief Release 构建 (NDEBUG) 下不做检查; 需要检查时用 at(r, c)
+   */
+  T& operator[](size_t r, size_t c) const {
+#ifndef NDEBUG
+    check(r, c);
+#endif
+    return ptr[r * row_stride + c];
+  }
+
+  T& at(size_t r, size_t c) const {
+    check(r, c);
+    return ptr[r * row_stride + c];
+  }
+
+  std::span<T> row(size_t r) const {
+#ifndef NDEBUG
+    if (r >= n_rows) {
+      throw std::out_of_range("row index is out of range.");
+    }
+#endif
+    return {ptr + r * row_stride, n_cols};
+  }
+
+  strided_span<T> col(size_t c) const {
+#ifndef NDEBUG
+    if (c >= n_cols) {
+      throw std::out_of_range("column index is out of range.");
+    }
+#endif
+    return {ptr + c, n_rows, (std::ptrdiff_t)row_stride};
+  }
+
+  matrix_view block(size_t r, size_t c, size_t h, size_t w) const {
+    if (r > n_rows || c > n_cols || h > n_rows - r || w > n_cols - c) {
+      throw std::out_of_range("block (r, c, h, w) is out of range.");
+    }
+    return {ptr + r * row_stride + c, h, w, row_stride};
+  }
+
+#if defined(__cpp_lib_mdspan)
+  using mdspan_t = std::mdspan<T, std::dextents<size_t, 2>, std::layout_stride>;
+
+  explicit matrix_view(const mdspan_t& m)
+      : matrix_view{m.data_handle(), m.extent(0), m.extent(1), m.stride(0)} {
+    if (m.extent(0) > 0 && m.extent(1) > 1 && m.stride(1) != 1) {
+      throw std::invalid_argument("mdspan with column stride != 1 cannot be viewed as matrix_view.");
+    }
+  }
+
+  explicit matrix_view(const std::mdspan<T, std::dextents<size_t, 2>>& m)
+      : matrix_view{m.data_handle(), m.extent(0), m.extent(1)} {}
+
+  mdspan_t to_mdspan() const {
+    using mapping_t = typename mdspan_t::mapping_type;
+    return mdspan_t{ptr, mapping_t{std::dextents<size_t, 2>{n_rows, n_cols},
+                                   std::array<size_t, 2>{row_stride, 1}}};
+  }
+#endif
+
+  friend std::ostream& operator<<(std::ostream& os, const matrix_view& obj) {
+    for (size_t r = 0; r < obj.n_rows; r++) {
+      for (const auto& item : obj.row(r)) {
+        os << item << ' ';
+      }
+      os << std::endl;
+    }
+    return os;
+  }
+
+ private:
+  T* ptr{};
+  size_t n_rows{};
+  size_t n_cols{};
+  size_t row_stride{};
+
+  void check(size_t r, size_t c) const {
+    if (ptr == nullptr) {
+      throw std::runtime_error("data of matrix is nullptr.");
+    }
+    if (r >= n_rows || c >= n_cols) {
+      throw std::out_of_range("index (r, c) is out of range.");
+    }
+  }
+};
+
+/**
+ * @brief 惰性的逐元素表达式 (见 matrix_expr.h)
+ * * `expr.row_fn(r)` 返回第 r 行的求值器, `expr.row_fn(r)(c)` 为元素 (r, c);
+ * 按行取求值器使内层循环只剩连续的下标 c, 编译器可以将整条表达式融合成一次向量化的遍历.
+ */
+template <typename E>
+concept matrix_expression = requires(const E& expr, size_t i) {
+  { expr.rows() } -> std::convertible_to<size_t>;
+  { expr.cols() } -> std::convertible_to<size_t>;
+  expr.row_fn(i)(i);
+};
+
+/**
+ * @brief 只求值 [r_begin, r_end) 这些行, 不检查尺寸 (供 assign 与并行求值使用)
+ */
+template <typename T, matrix_expression E>
+void assign_rows(matrix_view<T> out, const E& expr, size_t r_begin, size_t r_end) {
+  const size_t cols = out.cols();
+  for (size_t r = r_begin; r < r_end; r++) {
+    const auto fn = expr.row_fn(r);
+    T* dst = out.data() + r * out.stride();
+    for (size_t c = 0; c < cols; c++) {
+      dst[c] = static_cast<T>(fn(c));
+    }
+  }
+}
+
+/**
+ * @brief out = expr, 逐行一次遍历求值
+ * @note 元素 (r, c) 只依赖各操作数的 (r, c), 因此 out 可以是表达式中的某个操作数本身
+ * (如 `a = a + b`), 但不能与操作数错位重叠 (如同一矩阵的两个不同子块)
+ */
+template <typename T, matrix_expression E>
+void assign(matrix_view<T> out, const E& expr) {
+  if (out.rows() != expr.rows() || out.cols() != expr.cols()) {
+    throw std::invalid_argument("matrix dimensions do not match.");
+  }
+  assign_rows(out, expr, 0, out.rows());
+}
+
+/**
+ * @brief 拥有内存的行主序矩阵
+ * * 所有元素放在一块按 matrix_alignment 对齐的连续内存中, 行跨度 stride() 向上取整到
+ * cache line 的整数倍 (元素大小整除 cache line 时), 每一行的起点都是对齐的.
+ * 填充部分同样被值初始化, 不计入 rows() / cols().
+ * * `row(r)` / `col(c)` / `block(r, c, h, w)` / `view()` 都是不拷贝的视图,
+ * 生命周期不能超过矩阵本身.
+ */
+template <typename T>
+class Matrix2D {
+ public:
+  using value_type = T;
+
+  /**
+   * @brief 行跨度向上取整到 cache line; 为 1KB 整数倍时再多加一个 cache line,
+   * 否则同一列上的元素全部落在同一个缓存组里, 按列访问 (转置、打包) 时互相驱逐
+   * * 新分配的矩阵与 matrix_file.h 写出的文件都使用这个行跨度
+   */
+  static constexpr size_t padded_stride(size_t cols) noexcept {
+    if constexpr (matrix_alignment % sizeof(T) == 0) {
+      constexpr size_t lane = matrix_alignment / sizeof(T);
+      const size_t stride = (cols + lane - 1) / lane * lane;
+      return stride > 0 && stride * sizeof(T) % 1024 == 0 ? stride + lane : stride;
+    } else {
+      return cols;
+    }
+  }
+
+  Matrix2D() = default;
+
+  Matrix2D(size_t rows, size_t cols)
+      : n_rows{rows}, n_cols{cols}, row_stride{padded_stride(cols)} {
+    alloc();
+  }
+
+  Matrix2D(Matrix2D&& other) noexcept
+      : storage{std::move(other.storage)},
+        n_rows{std::exchange(other.n_rows, 0)},
+        n_cols{std::exchange(other.n_cols, 0)},
+        row_stride{std::exchange(other.row_stride, 0)} {}
+
+  Matrix2D& operator=(Matrix2D&& other) noexcept {
+    storage = std::move(other.storage);
+    n_rows = std::exchange(other.n_rows, 0);
+    n_cols = std::exchange(other.n_cols, 0);
+    row_stride = std::exchange(other.row_stride, 0);
+    return *this;
+  }
+
+  Matrix2D(const Matrix2D& other)
+      : n_rows{other.n_rows}, n_cols{other.n_cols}, row_stride{other.row_stride} {
+    if constexpr (std::is_trivially_copyable_v<T>) {
+      // 跨度相同: 不做值初始化, 连同填充一起整块拷贝
+      alloc(false);
+      if (storage) {
+        std::memcpy(storage.get(), other.storage.get(), n_rows * row_stride * sizeof(T));
+      }
+    } else {
+      alloc();
+      copy_from(other.view());
+    }
+  }
+
+  template <typename U>
+  Matrix2D(const Matrix2D<U>& other) : Matrix2D{other.rows(), other.cols()} {
+    copy_from(other.view());
+  }
+
+  template <typename U>
+  explicit Matrix2D(matrix_view<U> other) : Matrix2D{other.rows(), other.cols()} {
+    copy_from(other);
+  }
+
+  Matrix2D& operator=(const Matrix2D& other) {
+    if (this == &other) {
+      return *this;
+    }
+    *this = Matrix2D{other};
+    return *this;
+  }
+
+  template <typename U>
+  Matrix2D& operator=(const Matrix2D<U>& other) {
+    *this = Matrix2D{other};
+    return *this;
+  }
+
+  /**
+   * @brief 由表达式构造: 分配后一次遍历写入, 不先做值初始化
+   */
+  template <matrix_expression E>
+  Matrix2D(const E& expr)
+      : n_rows{expr.rows()}, n_cols{expr.cols()}, row_stride{padded_stride(expr.cols())} {
+    alloc(false);
+    assign(view(), expr);
+    if (row_stride > n_cols) {
+      for (size_t r = 0; r < n_rows; r++) {
+        std::fill(storage.get() + r * row_stride + n_cols, storage.get() + (r + 1) * row_stride, T{});
+      }
+    }
+  }
+
+  /**
+   * @brief 尺寸相同时原地求值, 否则重新分配
+   */
+  template <matrix_expression E>
+  Matrix2D& operator=(const E& expr) {
+    if (n_rows == expr.rows() && n_cols == expr.cols()) {
+      assign(view(), expr);
+    } else {
+      *this = Matrix2D{expr};
+    }
+    return *this;
+  }
+
+  size_t rows() const noexcept {
+    return n_rows;
+  }
+  size_t cols() const noexcept {
+    return n_cols;
+  }
+  size_t stride() const noexcept {
+    return row_stride;
+  }
+  T* data() noexcept {
+    return storage.get();
+  }
+  const T* data() const noexcept {
+    return storage.get();
+  }
+
+  matrix_view<T> view() noexcept {
+    return {storage.get(), n_rows, n_cols, row_stride};
+  }
+  matrix_view<const T> view() const noexcept {
+    return {storage.get(), n_rows, n_cols, row_stride};
+  }
+  operator matrix_view<T>() noexcept {
+    return view();
+  }
+  operator matrix_view<const T>() const noexcept {
+    return view();
+  }
+
+  /**
+   * @brief Release 构建 (NDEBUG) 下不做检查; 需要检查时用 at(r, c)
+   */
+  T& operator[](size_t r, size_t c) {
+    return view()[r, c];
+  }
+  const T& operator[](size_t r, size_t c) const {
+    return view()[r, c];
+  }
+
+  T& at(size_t r, size_t c) {
+    return view().at(r, c);
+  }
+  const T& at(size_t r, size_t c) const {
+    return view().at(r, c);
+  }
+
+  std::span<T> row(size_t r) {
+    return view().row(r);
+  }
+  std::span<const T> row(size_t r) const {
+    return view().row(r);
+  }
+  strided_span<T> col(size_t c) {
+    return view().col(c);
+  }
+  strided_span<const T> col(size_t c) const {
+    return view().col(c);
+  }
+  matrix_view<T> block(size_t r, size_t c, size_t h, size_t w) {
+    return view().block(r, c, h, w);
+  }
+  matrix_view<const T> block(size_t r, size_t c, size_t h, size_t w) const {
+    return view().block(r, c, h, w);
+  }
+
+#if defined(__cpp_lib_mdspan)
+  auto to_mdspan() {
+    return view().to_mdspan();
+  }
+  auto to_mdspan() const {
+    return view().to_mdspan();
+  }
+#endif
+
+  friend std::ostream& operator<<(std::ostream& os, const Matrix2D& obj) {
+    return os << obj.view();
+  }
+
+ private:
+  /**
+   * @brief 对齐分配的释放器, 记录元素个数以便析构
+   */
+  struct aligned_deleter {
+    size_t count{};
+
+    void operator()(T* ptr) const noexcept {
+      std::destroy_n(ptr, count);
+      ::operator delete(ptr, std::align_val_t{alignment()});
+    }
+  };
+
+  std::unique_ptr<T, aligned_deleter> storage{};
+  size_t n_rows{};
+  size_t n_cols{};
+  size_t row_stride{};
+
+  static constexpr size_t alignment() noexcept {
+    return std::max(matrix_alignment, alignof(T));
+  }
+
+  void alloc(bool value_init = true) {
+    const size_t count = n_rows * row_stride;
+    if (count == 0) {
+      return;
+    }
+    T* ptr = static_cast<T*>(::operator new(count * sizeof(T), std::align_val_t{alignment()}));
+    try {
+      if (value_init) {
+        std::uninitialized_value_construct_n(ptr, count);
+      } else {
+        std::uninitialized_default_construct_n(ptr, count);
+      }
+    } catch (...) {
+      ::operator delete(ptr, std::align_val_t{alignment()});
+      throw;
+    }
+    storage = std::unique_ptr<T, aligned_deleter>{ptr, aligned_deleter{count}};
+  }
+
+  template <typename U>
+    requires std::convertible_to<U, T> && std::copy_constructible<T>
+  void copy_from(matrix_view<U> other) {
+    for (size_t r = 0; r < n_rows; r++) {
+      std::ranges::copy(other.row(r), storage.get() + r * row_stride);
+    }
+  }
+};
+
+}  // namespace playground
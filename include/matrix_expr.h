@@ -0,0 +1,159 @@
+#pragma once
+
+#include <concepts>
+#include <cstddef>
+#include <functional>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+
+#include "matrix.h"
+
+namespace playground {
+
+/**
+ * @brief 表达式的叶子: 引用一个矩阵 (不拥有内存)
+ */
+template <typename T>
+struct matrix_leaf {
+  matrix_view<const T> m;
+
+  size_t rows() const noexcept {
+    return m.rows();
+  }
+  size_t cols() const noexcept {
+    return m.cols();
+  }
+  auto row_fn(size_t r) const noexcept {
+    return [p = m.data() + r * m.stride()](size_t c) { return p[c]; };
+  }
+};
+
+/**
+ * @brief 逐元素的二元运算节点, 构造时检查两侧尺寸一致
+ */
+template <typename Op, matrix_expression L, matrix_expression R>
+struct binary_expr {
+  L lhs;
+  R rhs;
+  [[no_unique_address]] Op op;
+
+  binary_expr(L lhs, R rhs, Op op) : lhs{std::move(lhs)}, rhs{std::move(rhs)}, op{std::move(op)} {
+    if (this->lhs.rows() != this->rhs.rows() || this->lhs.cols() != this->rhs.cols()) {
+      throw std::invalid_argument("matrix dimensions do not match.");
+    }
+  }
+
+  size_t rows() const noexcept {
+    return lhs.rows();
+  }
+  size_t cols() const noexcept {
+    return lhs.cols();
+  }
+  auto row_fn(size_t r) const {
+    return [l = lhs.row_fn(r), rr = rhs.row_fn(r), op = op](size_t c) { return op(l(c), rr(c)); };
+  }
+};
+
+/**
+ * @brief 逐元素的一元运算节点 (取负、与标量运算、map 传入的 lambda)
+ */
+template <typename F, matrix_expression E>
+struct unary_expr {
+  E expr;
+  [[no_unique_address]] F f;
+
+  size_t rows() const noexcept {
+    return expr.rows();
+  }
+  size_t cols() const noexcept {
+    return expr.cols();
+  }
+  auto row_fn(size_t r) const {
+    return [e = expr.row_fn(r), f = f](size_t c) { return f(e(c)); };
+  }
+};
+
+/**
+ * @brief 把操作数转换为表达式节点: Matrix2D / matrix_view 成为叶子, 表达式节点按值保存
+ * * 右值 Matrix2D 不能作为操作数: 表达式只保存视图, 临时矩阵在求值前就会被销毁
+ */
+template <typename T>
+matrix_leaf<T> as_expr(const Matrix2D<T>& m) noexcept {
+  return {m.view()};
+}
+
+template <typename T>
+void as_expr(Matrix2D<T>&& m) = delete;
+
+template <typename T>
+matrix_leaf<std::remove_const_t<T>> as_expr(matrix_view<T> m) noexcept {
+  return {m};
+}
+
+template <matrix_expression E>
+E as_expr(E expr) {
+  return expr;
+}
+
+template <typename X>
+concept matrix_operand = requires(X&& x) {
+  { as_expr(std::forward<X>(x)) } -> matrix_expression;
+};
+
+template <typename X>
+using expr_t = decltype(as_expr(std::declval<X>()));
+
+template <typename T>
+concept matrix_scalar = std::is_arithmetic_v<std::remove_cvref_t<T>>;
+
+template <matrix_operand L, matrix_operand R>
+auto operator+(L&& lhs, R&& rhs) {
+  return binary_expr<std::plus<>, expr_t<L>, expr_t<R>>{
+      as_expr(std::forward<L>(lhs)), as_expr(std::forward<R>(rhs)), {}};
+}
+
+template <matrix_operand L, matrix_operand R>
+auto operator-(L&& lhs, R&& rhs) {
+  return binary_expr<std::minus<>, expr_t<L>, expr_t<R>>{
+      as_expr(std::forward<L>(lhs)), as_expr(std::forward<R>(rhs)), {}};
+}
+
+/**
+ * @brief 逐元素乘积 (Hadamard product); 矩阵乘法见 matrix_multiply.h 的 multiply
+ */
+template <matrix_operand L, matrix_operand R>
+auto hadamard(L&& lhs, R&& rhs) {
+  return binary_expr<std::multiplies<>, expr_t<L>, expr_t<R>>{
+      as_expr(std::forward<L>(lhs)), as_expr(std::forward<R>(rhs)), {}};
+}
+
+/**
+ * @brief 逐元素应用 f, 例如 `map(a, [](float x) { return std::max(x, 0.0f); })`
+ */
+template <matrix_operand E, typename F>
+auto map(E&& expr, F f) {
+  return unary_expr<F, expr_t<E>>{as_expr(std::forward<E>(expr)), std::move(f)};
+}
+
+template <matrix_operand E>
+auto operator-(E&& expr) {
+  return map(std::forward<E>(expr), std::negate<>{});
+}
+
+template <matrix_scalar S, matrix_operand E>
+auto operator*(S s, E&& expr) {
+  return map(std::forward<E>(expr), [s](const auto& x) { return s * x; });
+}
+
+template <matrix_operand E, matrix_scalar S>
+auto operator*(E&& expr, S s) {
+  return map(std::forward<E>(expr), [s](const auto& x) { return x * s; });
+}
+
+template <matrix_operand E, matrix_scalar S>
+auto operator/(E&& expr, S s) {
+  return map(std::forward<E>(expr), [s](const auto& x) { return x / s; });
+}
+
+}  // namespace playground
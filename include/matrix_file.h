@@ -0,0 +1,386 @@
+#pragma once
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <concepts>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <format>
+#include <functional>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "matrix.h"
+
+namespace playground {
+
+enum class matrix_dtype : uint32_t { i8 = 1, u8, i16, u16, i32, u32, i64, u64, f32, f64 };
+
+template <typename T>
+concept matrix_file_element =
+    (std::is_integral_v<T> && !std::same_as<T, bool> && sizeof(T) <= 8) || std::same_as<T, float> ||
+    std::same_as<T, double>;
+
+template <matrix_file_element T>
+constexpr matrix_dtype dtype_of() noexcept {
+  if constexpr (std::same_as<T, float>) {
+    return matrix_dtype::f32;
+  } else if constexpr (std::same_as<T, double>) {
+    return matrix_dtype::f64;
+  } else {
+    constexpr uint32_t log2_size = sizeof(T) == 1 ? 0 : sizeof(T) == 2 ? 1 : sizeof(T) == 4 ? 2 : 3;
+    return static_cast<matrix_dtype>(1 + 2 * log2_size + (std::is_signed_v<T> ? 0 : 1));
+  }
+}
+
+/**
+ * @brief 矩阵文件的头部, 位于文件开头
+ * * 数据从 data_offset (4KB, 页对齐) 开始逐行存放, 行跨度 stride 与 Matrix2D 相同, 每行起点
+ * alignment 字节对齐, 行尾的填充为 0; 映射后可以直接作为 matrix_view 使用.
+ * * 各字段均为本机字节序, 读取时由 byte_order 检查; 写入未完成的文件 magic 为 0.
+ */
+struct matrix_file_header {
+  static constexpr std::array<char, 8> file_magic{'P', 'G', 'M', 'A', 'T', '0', '0', '1'};
+  static constexpr uint32_t native_byte_order = 0x01020304;
+  static constexpr size_t default_data_offset = 4096;
+
+  std::array<char, 8> magic;
+  uint32_t byte_order;
+  matrix_dtype dtype;
+  uint64_t elem_size;
+  uint64_t rows;
+  uint64_t cols;
+  uint64_t stride;  // 以元素计
+  uint64_t alignment;
+  uint64_t data_offset;
+};
+
+namespace matrix_file_detail {
+
+[[noreturn]] inline void throw_errno(const std::string& what) {
+  throw std::system_error{errno, std::generic_category(), what};
+}
+
+template <typename T>
+void check_header(const matrix_file_header& header, size_t file_size,
+                  const std::filesystem::path& path) {
+  auto fail = [&](const char* why) {
+    throw std::runtime_error{std::format("matrix file {}: {}", path.string(), why)};
+  };
+  if (header.magic != matrix_file_header::file_magic) {
+    fail("bad magic (not a matrix file, or not finished)");
+  }
+  if (header.byte_order != matrix_file_header::native_byte_order) {
+    fail("byte order does not match this machine");
+  }
+  if (header.dtype != dtype_of<T>() || header.elem_size != sizeof(T)) {
+    fail("element type does not match");
+  }
+  if (header.stride < header.cols || header.data_offset % alignof(T) != 0 ||
+      header.data_offset < sizeof(matrix_file_header)) {
+    fail("bad layout");
+  }
+  // 按除法比较, 损坏的头部中很大的 rows / stride 不会使乘法溢出
+  if (header.data_offset > file_size ||
+      (header.stride > 0 &&
+       header.rows > (file_size - header.data_offset) / sizeof(T) / header.stride)) {
+    fail("file is truncated");
+  }
+}
+
+}  // namespace matrix_file_detail
+
+/**
+ * @brief 只读映射的矩阵文件
+ * * 用法: `mapped_matrix<float> m{path}; matrix_view<const float> v = m.view();`
+ * * 构造时只映射不读取, 页面在首次访问时由内核按需载入; 视图的生命周期不能超过本对象.
+ * * for_each_tile 用于核外 (out-of-core) 计算: 常驻内存只有当前与下一个行带, 文件可以比物理内存大.
+ */
+template <matrix_file_element T>
+class mapped_matrix {
+ public:
+  explicit mapped_matrix(const std::filesystem::path& path) {
+    const int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+      matrix_file_detail::throw_errno(std::format("open {}", path.string()));
+    }
+    struct stat st {};
+    if (::fstat(fd, &st) != 0) {
+      ::close(fd);
+      matrix_file_detail::throw_errno(std::format("fstat {}", path.string()));
+    }
+    if ((size_t)st.st_size < sizeof(matrix_file_header)) {
+      ::close(fd);
+      throw std::runtime_error{std::format("matrix file {}: file is truncated", path.string())};
+    }
+    mapped_bytes = (size_t)st.st_size;
+    void* p = ::mmap(nullptr, mapped_bytes, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);  // 映射持有文件的引用
+    if (p == MAP_FAILED) {
+      matrix_file_detail::throw_errno(std::format("mmap {}", path.string()));
+    }
+    base = static_cast<const std::byte*>(p);
+    std::memcpy(&header_, base, sizeof(header_));
+    try {
+      matrix_file_detail::check_header<T>(header_, mapped_bytes, path);
+    } catch (...) {
+      ::munmap(const_cast<std::byte*>(base), mapped_bytes);
+      throw;
+    }
+  }
+
+  mapped_matrix(mapped_matrix&& other) noexcept
+      : base{std::exchange(other.base, nullptr)},
+        mapped_bytes{std::exchange(other.mapped_bytes, 0)},
+        header_{other.header_} {}
+
+  mapped_matrix& operator=(mapped_matrix&& other) noexcept {
+    if (this != &other) {
+      unmap();
+      base = std::exchange(other.base, nullptr);
+      mapped_bytes = std::exchange(other.mapped_bytes, 0);
+      header_ = other.header_;
+    }
+    return *this;
+  }
+
+  mapped_matrix(const mapped_matrix&) = delete;
+  mapped_matrix& operator=(const mapped_matrix&) = delete;
+
+  ~mapped_matrix() {
+    unmap();
+  }
+
+  size_t rows() const noexcept {
+    return header_.rows;
+  }
+  size_t cols() const noexcept {
+    return header_.cols;
+  }
+  const matrix_file_header& header() const noexcept {
+    return header_;
+  }
+
+  matrix_view<const T> view() const noexcept {
+    return {reinterpret_cast<const T*>(base + header_.data_offset), header_.rows, header_.cols,
+            header_.stride};
+  }
+
+  operator matrix_view<const T>() const noexcept {
+    return view();
+  }
+
+  /**
+   * @brief 按 tile_rows x tile_cols 的分块逐个调用 f(row, col, block), 行优先
+   * * 每个行带开始前 MADV_WILLNEED 预读下一个行带, 行带结束后 MADV_DONTNEED 释放它的映射页
+   * (只读的文件页不会丢失数据, 再次访问时重新载入)
+   */
+  template <std::invocable<size_t, size_t, matrix_view<const T>> F>
+  void for_each_tile(size_t tile_rows, size_t tile_cols, F f) const {
+    if (tile_rows == 0 || tile_cols == 0) {
+      throw std::invalid_argument("tile size must be positive.");
+    }
+    const auto m = view();
+    advise(0, std::min(tile_rows, rows()), MADV_WILLNEED);
+    for (size_t r = 0; r < rows(); r += tile_rows) {
+      const size_t h = std::min(tile_rows, rows() - r);
+      advise(r + h, std::min(r + h + tile_rows, rows()), MADV_WILLNEED);
+      for (size_t c = 0; c < cols(); c += tile_cols) {
+        std::invoke(f, r, c, m.block(r, c, h, std::min(tile_cols, cols() - c)));
+      }
+      advise(r, r + h, MADV_DONTNEED);
+    }
+  }
+
+ private:
+  const std::byte* base{nullptr};
+  size_t mapped_bytes{};
+  matrix_file_header header_{};
+
+  void unmap() noexcept {
+    if (base != nullptr) {
+      ::munmap(const_cast<std::byte*>(base), mapped_bytes);
+      base = nullptr;
+    }
+  }
+
+  /**
+   * @brief 对 [row_begin, row_end) 行所在的页调用 madvise, 起点向下取整到页边界
+   * * 内核把长度向上取整到整页. MADV_DONTNEED 时终点向下取整 (最后一行除外),
+   * 不释放与下一个行带共用、刚被 MADV_WILLNEED 预读的页
+   */
+  void advise(size_t row_begin, size_t row_end, int advice) const noexcept {
+    if (row_begin >= row_end) {
+      return;
+    }
+    static const size_t page = (size_t)::sysconf(_SC_PAGESIZE);
+    const size_t row_bytes = header_.stride * sizeof(T);
+    const size_t begin = (header_.data_offset + row_begin * row_bytes) / page * page;
+    size_t end = header_.data_offset + row_end * row_bytes;
+    if (advice == MADV_DONTNEED && row_end < rows()) {
+      end = end / page * page;
+    }
+    if (end > begin) {
+      ::madvise(const_cast<std::byte*>(base + begin), end - begin, advice);
+    }
+  }
+};
+
+/**
+ * @brief 逐行追加写入矩阵文件, 只缓冲 buffer_bytes 字节, 不需要把整个矩阵放在内存中
+ * * 用法: `matrix_file_writer<float> w{path, cols}; w.append_row(row); ...; w.finish();`
+ * * 文件头在 finish() 时写入 (行数此时才确定); 未 finish 的文件 magic 为 0, 打开时会被拒绝.
+ * finish() 是发布文件的唯一途径: 析构 (包括异常导致的提前析构) 只关闭文件, 不写文件头,
+ * 因此写到一半的文件不会被当作完整的矩阵.
+ */
+template <matrix_file_element T>
+class matrix_file_writer {
+ public:
+  matrix_file_writer(const std::filesystem::path& path, size_t cols, size_t buffer_bytes = 1 << 20)
+      : path{path}, n_cols{cols}, stride{Matrix2D<T>::padded_stride(cols)} {
+    fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) {
+      matrix_file_detail::throw_errno(std::format("open {}", path.string()));
+    }
+    buffer.resize(std::max({buffer_bytes, stride * sizeof(T),
+                            matrix_file_header::default_data_offset}));
+    used = matrix_file_header::default_data_offset;  // 先写入全 0 的文件头占位
+  }
+
+  matrix_file_writer(const matrix_file_writer&) = delete;
+  matrix_file_writer& operator=(const matrix_file_writer&) = delete;
+
+  ~matrix_file_writer() {
+    if (fd >= 0) {
+      ::close(fd);
+    }
+  }
+
+  size_t rows() const noexcept {
+    return n_rows;
+  }
+  size_t cols() const noexcept {
+    return n_cols;
+  }
+
+  void append_row(std::span<const T> row) {
+    if (fd < 0) {
+      throw std::logic_error("matrix_file_writer: already finished.");
+    }
+    if (row.size() != n_cols) {
+      throw std::invalid_argument("row size does not match matrix columns.");
+    }
+    const size_t row_bytes = stride * sizeof(T);
+    if (buffer.size() - used < row_bytes) {
+      flush();
+    }
+    std::ranges::copy(std::as_bytes(row), buffer.data() + used);
+    std::memset(buffer.data() + used + n_cols * sizeof(T), 0, (stride - n_cols) * sizeof(T));
+    used += row_bytes;
+    n_rows++;
+  }
+
+  template <typename U>
+    requires std::same_as<std::remove_const_t<U>, T>
+  void append_rows(matrix_view<U> m) {
+    for (size_t r = 0; r < m.rows(); r++) {
+      append_row(m.row(r));
+    }
+  }
+
+  /**
+   * @brief 写出缓冲区与文件头并 fdatasync, 之后文件可以被 mapped_matrix 打开
+   */
+  void finish() {
+    if (fd < 0) {
+      return;
+    }
+    flush();
+    const matrix_file_header header{.magic = matrix_file_header::file_magic,
+                                    .byte_order = matrix_file_header::native_byte_order,
+                                    .dtype = dtype_of<T>(),
+                                    .elem_size = sizeof(T),
+                                    .rows = n_rows,
+                                    .cols = n_cols,
+                                    .stride = stride,
+                                    .alignment = matrix_alignment,
+                                    .data_offset = matrix_file_header::default_data_offset};
+    write_all(&header, sizeof(header), 0);
+    if (::fdatasync(fd) != 0) {
+      matrix_file_detail::throw_errno(std::format("fdatasync {}", path.string()));
+    }
+    ::close(std::exchange(fd, -1));
+  }
+
+ private:
+  std::filesystem::path path;
+  int fd{-1};
+  size_t n_cols;
+  size_t stride;
+  size_t n_rows{0};
+  size_t written{0};  // 已写入文件的字节数
+  std::vector<std::byte> buffer;
+  size_t used{0};
+
+  void flush() {
+    write_all(buffer.data(), used, written);
+    written += used;
+    used = 0;
+  }
+
+  void write_all(const void* data, size_t size, size_t offset) {
+    auto p = static_cast<const std::byte*>(data);
+    while (size > 0) {
+      const ssize_t n = ::pwrite(fd, p, size, (off_t)offset);
+      if (n < 0) {
+        if (errno == EINTR) {
+          continue;
+        }
+        matrix_file_detail::throw_errno(std::format("write {}", path.string()));
+      }
+      p += n;
+      size -= (size_t)n;
+      offset += (size_t)n;
+    }
+  }
+};
+
+/**
+ * @brief 把整个矩阵写为矩阵文件
+ */
+template <typename U>
+  requires matrix_file_element<std::remove_const_t<U>>
+void save_matrix(const std::filesystem::path& path, matrix_view<U> m) {
+  matrix_file_writer<std::remove_const_t<U>> writer{path, m.cols()};
+  writer.append_rows(m);
+  writer.finish();
+}
+
+template <matrix_file_element T>
+void save_matrix(const std::filesystem::path& path, const Matrix2D<T>& m) {
+  save_matrix(path, m.view());
+}
+
+/**
+ * @brief 把矩阵文件读入内存: 映射后复制到新的 Matrix2D
+ */
+template <matrix_file_element T>
+Matrix2D<T> load_matrix(const std::filesystem::path& path) {
+  const mapped_matrix<T> mapped{path};
+  return Matrix2D<T>{mapped.view()};
+}
+
+}  // namespace playground
@@ -0,0 +1,312 @@
+#pragma once
+
+#include <unistd.h>
+
+#include <algorithm>
+#include <concepts>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <new>
+#include <stdexcept>
+#include <type_traits>
+
+#include "matrix.h"
+#include "matrix_simd.h"
+#include "matrix_transpose.h"
+
+namespace playground {
+
+template <typename T>
+concept gemm_element = std::same_as<T, float> || std::same_as<T, double> || std::same_as<T, int32_t>;
+
+/**
+ * @brief 寄存器分块的微内核: C[mr x nr] += A_pack[mr x kc] * B_pack[kc x nr]
+ * * A_pack 按列存放 mr 个元素一组, B_pack 按行存放 nr 个元素一组 (见 pack_a / pack_b)
+ */
+template <typename T>
+struct gemm_kernel {
+  using fn_t = void (*)(size_t kc, const T* a, const T* b, T* c, size_t ldc);
+
+  simd_level level;
+  size_t mr;
+  size_t nr;
+  fn_t fn;
+};
+
+/**
+ * @brief 三级分块: B 的 kc x nr 小条留在 L1, A 的 mc x kc 块留在 L2, B 的 kc x nc 面板留在 L3
+ */
+struct gemm_blocking {
+  size_t mc;
+  size_t nc;
+  size_t kc;
+
+  template <typename T>
+  static gemm_blocking for_kernel(const gemm_kernel<T>& kernel);
+};
+
+namespace gemm_detail {
+
+/**
+ * @brief 微内核本体, 以 always_inline 展开进各个指令集的包装函数中, 由编译器按该函数的
+ * target 生成对应宽度的向量指令
+ * @tparam Bytes 向量寄存器宽度
+ * @tparam MR 每次计算的 A 行数
+ * @tparam NV 每次计算的 B 列数 (以向量计)
+ */
+template <typename T, size_t Bytes, size_t MR, size_t NV>
+[[gnu::always_inline]] inline void micro_kernel(size_t kc, const T* a, const T* b, T* c,
+                                                size_t ldc) {
+  using vec_t = typename simd_vec<T, Bytes>::type;
+  constexpr size_t lanes = Bytes / sizeof(T);
+
+  vec_t acc[MR][NV]{};
+  for (size_t p = 0; p < kc; p++) {
+    vec_t bv[NV];
+#pragma GCC unroll 8
+    for (size_t v = 0; v < NV; v++) {
+      std::memcpy(&bv[v], b + v * lanes, Bytes);
+    }
+#pragma GCC unroll 16
+    for (size_t i = 0; i < MR; i++) {
+      const vec_t av = vec_t{} + a[i];
+#pragma GCC unroll 8
+      for (size_t v = 0; v < NV; v++) {
+        acc[i][v] += av * bv[v];
+      }
+    }
+    a += MR;
+    b += NV * lanes;
+  }
+#pragma GCC unroll 16
+  for (size_t i = 0; i < MR; i++) {
+#pragma GCC unroll 8
+    for (size_t v = 0; v < NV; v++) {
+      vec_t cv;
+      std::memcpy(&cv, c + i * ldc + v * lanes, Bytes);
+      cv += acc[i][v];
+      std::memcpy(c + i * ldc + v * lanes, &cv, Bytes);
+    }
+  }
+}
+
+template <typename T, size_t MR, size_t NV>
+void micro_kernel_portable(size_t kc, const T* a, const T* b, T* c, size_t ldc) {
+  micro_kernel<T, 16, MR, NV>(kc, a, b, c, ldc);
+}
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+template <typename T, size_t MR, size_t NV>
+[[gnu::target("avx2,fma")]] void micro_kernel_avx2(size_t kc, const T* a, const T* b, T* c,
+                                                   size_t ldc) {
+  micro_kernel<T, 32, MR, NV>(kc, a, b, c, ldc);
+}
+
+template <typename T, size_t MR, size_t NV>
+[[gnu::target("avx512f")]] void micro_kernel_avx512(size_t kc, const T* a, const T* b, T* c,
+                                                    size_t ldc) {
+  micro_kernel<T, 64, MR, NV>(kc, a, b, c, ldc);
+}
+#endif
+
+/**
+ * @brief 每线程复用的对齐缓冲区, 存放打包后的 A / B
+ */
+template <typename T>
+T* pack_buffer(size_t slot, size_t count) {
+  struct buffer {
+    std::unique_ptr<T, void (*)(T*)> data{nullptr, [](T* p) {
+                                            ::operator delete(p, std::align_val_t{matrix_alignment});
+                                          }};
+    size_t capacity{};
+  };
+  thread_local buffer buffers[2];
+  buffer& buf = buffers[slot];
+  if (buf.capacity < count) {
+    buf.data.reset(
+        static_cast<T*>(::operator new(count * sizeof(T), std::align_val_t{matrix_alignment})));
+    buf.capacity = count;
+  }
+  return buf.data.get();
+}
+
+/**
+ * @brief 把 A[0:mc, 0:kc] 打包成 mr 行一组的小条, 每组内按列连续, 不足 mr 行的部分补 0
+ * * 每个小条就是 A 的 mr x kc 子块转置为 kc x mr (行跨度 mr), 由 transpose 的块内核完成
+ */
+template <typename T>
+void pack_a(matrix_view<const T> a, size_t mr, T* out) {
+  const size_t mc = a.rows();
+  const size_t kc = a.cols();
+  const auto* kernels = transpose_kernels_for<T>(detect_simd_level());
+  for (size_t ir = 0; ir < mc; ir += mr) {
+    const size_t h = std::min(mr, mc - ir);
+    transpose_detail::transpose_recursive<T>(a.data() + ir * a.stride(), a.stride(), out, mr, h, kc,
+                                             kernels);
+    if (h < mr) {
+      for (size_t p = 0; p < kc; p++) {
+        std::fill(out + p * mr + h, out + (p + 1) * mr, T{});
+      }
+    }
+    out += mr * kc;
+  }
+}
+
+/**
+ * @brief 把 B[0:kc, 0:nc] 打包成 nr 列一组的小条, 每组内按行连续, 不足 nr 列的部分补 0
+ */
+template <typename T>
+void pack_b(matrix_view<const T> b, size_t nr, T* out) {
+  const size_t kc = b.rows();
+  const size_t nc = b.cols();
+  for (size_t jr = 0; jr < nc; jr += nr) {
+    const size_t w = std::min(nr, nc - jr);
+    for (size_t p = 0; p < kc; p++) {
+      const T* src = b.data() + p * b.stride() + jr;
+      std::copy(src, src + w, out);
+      std::fill(out + w, out + nr, T{});
+      out += nr;
+    }
+  }
+}
+
+struct cache_sizes {
+  size_t l1;
+  size_t l2;
+  size_t l3;
+
+  static const cache_sizes& detect() {
+    static const cache_sizes sizes = [] {
+      cache_sizes result{32 * 1024, 512 * 1024, 8 * 1024 * 1024};
+#if defined(_SC_LEVEL1_DCACHE_SIZE)
+      auto query = [](int name, size_t& value) {
+        const long size = ::sysconf(name);
+        if (size > 0) {
+          value = (size_t)size;
+        }
+      };
+      query(_SC_LEVEL1_DCACHE_SIZE, result.l1);
+      query(_SC_LEVEL2_CACHE_SIZE, result.l2);
+      query(_SC_LEVEL3_CACHE_SIZE, result.l3);
+#endif
+      return result;
+    }();
+    return sizes;
+  }
+};
+
+}  // namespace gemm_detail
+
+template <typename T>
+gemm_blocking gemm_blocking::for_kernel(const gemm_kernel<T>& kernel) {
+  const auto& caches = gemm_detail::cache_sizes::detect();
+  // 各级缓存只用一半, 留给 C 和其他数据
+  size_t kc = caches.l1 / 2 / (kernel.nr * sizeof(T));
+  kc = std::clamp<size_t>(kc / 8 * 8, 64, 512);
+  size_t mc = caches.l2 / 2 / (kc * sizeof(T));
+  mc = std::clamp<size_t>(mc / kernel.mr * kernel.mr, kernel.mr, 1024 / kernel.mr * kernel.mr);
+  size_t nc = caches.l3 / 2 / (kc * sizeof(T));
+  nc = std::clamp<size_t>(nc / kernel.nr * kernel.nr, kernel.nr, 8192 / kernel.nr * kernel.nr);
+  return {.mc = mc, .nc = nc, .kc = kc};
+}
+
+/**
+ * @brief 指定指令集的微内核; 当前 CPU 或编译器不支持时退回到 portable
+ * * avx2: 6 x 2 个 ymm 累加器; avx512: 6 x 2 个 zmm 累加器; portable: 4 x 2 个 16 字节向量
+ */
+template <gemm_element T>
+const gemm_kernel<T>& gemm_kernel_for(simd_level level) {
+  using namespace gemm_detail;
+  constexpr size_t lanes16 = 16 / sizeof(T);
+  static const gemm_kernel<T> portable{simd_level::portable, 4, 2 * lanes16,
+                                       &micro_kernel_portable<T, 4, 2>};
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+  static const gemm_kernel<T> avx2{simd_level::avx2, 6, 4 * lanes16, &micro_kernel_avx2<T, 6, 2>};
+  static const gemm_kernel<T> avx512{simd_level::avx512, 6, 8 * lanes16,
+                                     &micro_kernel_avx512<T, 6, 2>};
+  level = std::min(level, detect_simd_level());
+  if (level == simd_level::avx512) {
+    return avx512;
+  }
+  if (level == simd_level::avx2) {
+    return avx2;
+  }
+#endif
+  return portable;
+}
+
+/**
+ * @brief C += A * B, 三级分块 + 打包 + 寄存器分块微内核
+ * * a / b / c 可以是任意的子矩阵视图; c 不能与 a / b 重叠
+ */
+template <gemm_element T>
+void multiply_add(matrix_view<T> c, matrix_view<const T> a, matrix_view<const T> b,
+                  const gemm_kernel<T>& kernel = gemm_kernel_for<T>(detect_simd_level())) {
+  if (a.cols() != b.rows() || c.rows() != a.rows() || c.cols() != b.cols()) {
+    throw std::invalid_argument("matrix dimensions do not match.");
+  }
+  const size_t m = a.rows();
+  const size_t n = b.cols();
+  const size_t k = a.cols();
+  if (m == 0 || n == 0 || k == 0) {
+    return;
+  }
+  const size_t mr = kernel.mr;
+  const size_t nr = kernel.nr;
+  const gemm_blocking blocking = gemm_blocking::for_kernel(kernel);
+
+  const size_t mc_max = std::min(blocking.mc, (m + mr - 1) / mr * mr);
+  const size_t nc_max = std::min(blocking.nc, (n + nr - 1) / nr * nr);
+  const size_t kc_max = std::min(blocking.kc, k);
+  T* a_pack = gemm_detail::pack_buffer<T>(0, mc_max * kc_max);
+  T* b_pack = gemm_detail::pack_buffer<T>(1, kc_max * nc_max);
+  alignas(matrix_alignment) T edge[16 * 64]{};  // 边缘不完整的小块先算到这里
+
+  for (size_t jc = 0; jc < n; jc += blocking.nc) {
+    const size_t nc = std::min(blocking.nc, n - jc);
+    for (size_t pc = 0; pc < k; pc += blocking.kc) {
+      const size_t kc = std::min(blocking.kc, k - pc);
+      gemm_detail::pack_b(b.block(pc, jc, kc, nc), nr, b_pack);
+      for (size_t ic = 0; ic < m; ic += blocking.mc) {
+        const size_t mc = std::min(blocking.mc, m - ic);
+        gemm_detail::pack_a(a.block(ic, pc, mc, kc), mr, a_pack);
+        for (size_t jr = 0; jr < nc; jr += nr) {
+          const size_t w = std::min(nr, nc - jr);
+          for (size_t ir = 0; ir < mc; ir += mr) {
+            const size_t h = std::min(mr, mc - ir);
+            const T* ap = a_pack + ir * kc;
+            const T* bp = b_pack + jr * kc;
+            T* cp = c.data() + (ic + ir) * c.stride() + jc + jr;
+            if (h == mr && w == nr) {
+              kernel.fn(kc, ap, bp, cp, c.stride());
+              continue;
+            }
+            std::fill(edge, edge + mr * nr, T{});
+            kernel.fn(kc, ap, bp, edge, nr);
+            for (size_t i = 0; i < h; i++) {
+              for (size_t j = 0; j < w; j++) {
+                cp[i * c.stride() + j] += edge[i * nr + j];
+              }
+            }
+          }
+        }
+      }
+    }
+  }
+}
+
+template <gemm_element T>
+Matrix2D<T> multiply(matrix_view<const T> a, matrix_view<const T> b) {
+  Matrix2D<T> c{a.rows(), b.cols()};
+  multiply_add<T>(c.view(), a, b);
+  return c;
+}
+
+template <gemm_element T>
+Matrix2D<T> multiply(const Matrix2D<T>& a, const Matrix2D<T>& b) {
+  return multiply<T>(a.view(), b.view());
+}
+
+}  // namespace playground
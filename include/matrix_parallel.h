@@ -0,0 +1,294 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cmath>
+#include <concepts>
+#include <coroutine>
+#include <cstddef>
+#include <exception>
+#include <functional>
+#include <span>
+#include <stdexcept>
+#include <thread>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "async_tool.h"
+#include "matrix.h"
+#include "matrix_expr.h"
+#include "matrix_multiply.h"
+#include "sparse_matrix.h"
+
+namespace async {
+
+/**
+ * @brief 二维网格上的一个分块 (以块为单位的行号 / 列号)
+ */
+struct tile_index {
+  size_t row;
+  size_t col;
+};
+
+/**
+ * @brief rows x cols 个分块按 Z 序 (Morton order) 排列
+ * * 相邻的分块共享同一行块或同一列块; 从 FIFO 的线程池中被并发取走的一批分块聚在一个近似
+ * 正方形的区域内, 读取的 A 行块与 B 列块总量最小, 更容易留在共享的 L3 中.
+ */
+inline std::vector<tile_index> z_order_tiles(size_t rows, size_t cols) {
+  std::vector<tile_index> tiles;
+  tiles.reserve(rows * cols);
+  const size_t side = std::bit_ceil(std::max<size_t>({rows, cols, 1}));
+  for (size_t code = 0; code < side * side; code++) {
+    size_t r = 0;
+    size_t c = 0;
+    for (size_t bit = 0; (side >> bit) > 1; bit++) {
+      c |= ((code >> (2 * bit)) & 1) << bit;
+      r |= ((code >> (2 * bit + 1)) & 1) << bit;
+    }
+    if (r < rows && c < cols) {
+      tiles.push_back(tile_index{.row = r, .col = c});
+    }
+  }
+  return tiles;
+}
+
+/**
+ * @brief 并发执行 count 个分块任务 (Awaitable)
+ * * 用法: `co_await async::parallel_for_tiles(count, work, executor);`
+ * * 行为: 每个分块是一个协程, 先 `execute_by(executor)` 切换到执行器上再调用 `work(i)`,
+ * 按 i 的顺序投递; 当前协程挂起而不阻塞线程, 最后一个完成的分块在其所在线程上 resume 当前协程.
+ * 分块抛出的第一个异常在 await_resume 中重新抛出.
+ */
+template <typename F, typename Executor>
+struct parallel_tiles_awaiter {
+  size_t count;
+  F work;
+  Executor& executor;
+  std::atomic<size_t> remaining{0};
+  std::atomic<bool> failed{false};
+  std::exception_ptr e_ptr{nullptr};
+
+  co_task run_one(size_t i, std::coroutine_handle<> h) {
+    co_await execute_by(executor);
+    try {
+      std::invoke(work, i);
+    } catch (...) {
+      if (!failed.exchange(true, std::memory_order_acq_rel)) {
+        e_ptr = std::current_exception();
+      }
+    }
+    if (remaining.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+      h.resume();
+    }
+  }
+
+  bool await_ready() const noexcept {
+    return count == 0;
+  }
+
+  void await_suspend(std::coroutine_handle<> h) {
+    const size_t n = count;  // 最后一个分块完成后本对象可能已被销毁, 不能再读成员
+    remaining.store(n, std::memory_order_relaxed);
+    for (size_t i = 0; i < n; i++) {
+      run_one(i, h).detach();
+    }
+  }
+
+  void await_resume() {
+    if (e_ptr) {
+      std::rethrow_exception(e_ptr);
+    }
+  }
+};
+
+template <std::invocable<size_t> F, typename Executor>
+auto parallel_for_tiles(size_t count, F work, Executor& executor) {
+  return parallel_tiles_awaiter<F, Executor>{.count = count, .work = std::move(work),
+                                             .executor = executor};
+}
+
+/**
+ * @brief 执行器的并发度: 有 concurrency() 时使用, 否则取硬件线程数
+ */
+template <typename Executor>
+size_t executor_concurrency(const Executor& executor) {
+  if constexpr (requires { executor.concurrency(); }) {
+    return std::max<size_t>(executor.concurrency(), 1);
+  } else {
+    return std::max<unsigned>(std::thread::hardware_concurrency(), 1);
+  }
+}
+
+/**
+ * @brief 并行 C += A * B (Awaitable)
+ * * 用法: `co_await async::parallel_multiply_add(c, a, b, executor);`
+ * * C 被切分为 tile x tile 左右的分块 (行数、列数分别取微内核 mr / nr 的整数倍), 按 Z 序投递,
+ * 每个分块在执行器线程上调用 playground::multiply_add. tile 为 0 时按执行器并发度自动选择,
+ * 使每条线程分到约 4 个分块.
+ */
+template <playground::gemm_element T, typename Executor>
+co_task parallel_multiply_add(playground::matrix_view<T> c, playground::matrix_view<const T> a,
+                              playground::matrix_view<const T> b, Executor& executor,
+                              size_t tile = 0) {
+  if (a.cols() != b.rows() || c.rows() != a.rows() || c.cols() != b.cols()) {
+    throw std::invalid_argument("matrix dimensions do not match.");
+  }
+  const auto& kernel = playground::gemm_kernel_for<T>(playground::detect_simd_level());
+  if (tile == 0) {
+    const double per_task = (double)c.rows() * c.cols() / (4.0 * executor_concurrency(executor));
+    tile = std::clamp<size_t>((size_t)std::sqrt(per_task), 128, 1024);
+  }
+  const size_t tile_m = std::max(tile / kernel.mr, (size_t)1) * kernel.mr;
+  const size_t tile_n = std::max(tile / kernel.nr, (size_t)1) * kernel.nr;
+  const auto tiles =
+      z_order_tiles((c.rows() + tile_m - 1) / tile_m, (c.cols() + tile_n - 1) / tile_n);
+
+  co_await parallel_for_tiles(
+      tiles.size(),
+      [&](size_t i) {
+        const size_t r = tiles[i].row * tile_m;
+        const size_t col = tiles[i].col * tile_n;
+        const size_t h = std::min(tile_m, c.rows() - r);
+        const size_t w = std::min(tile_n, c.cols() - col);
+        playground::multiply_add<T>(c.block(r, col, h, w), a.block(r, 0, h, a.cols()),
+                                    b.block(0, col, b.rows(), w), kernel);
+      },
+      executor);
+}
+
+/**
+ * @brief 并行矩阵乘法
+ * * 用法: `auto c = co_await async::parallel_multiply(a, b, executor);`
+ */
+template <playground::gemm_element T, typename Executor>
+co_task_with<playground::Matrix2D<T>> parallel_multiply(playground::matrix_view<const T> a,
+                                                        playground::matrix_view<const T> b,
+                                                        Executor& executor, size_t tile = 0) {
+  playground::Matrix2D<T> c{a.rows(), b.cols()};
+  co_await parallel_multiply_add<T>(c.view(), a, b, executor, tile);
+  co_return c;
+}
+
+template <playground::gemm_element T, typename Executor>
+co_task_with<playground::Matrix2D<T>> parallel_multiply(const playground::Matrix2D<T>& a,
+                                                        const playground::Matrix2D<T>& b,
+                                                        Executor& executor, size_t tile = 0) {
+  return parallel_multiply<T>(a.view(), b.view(), executor, tile);
+}
+
+/**
+ * @brief 并行逐元素运算: out[r, c] = f(in[r, c]...) (Awaitable)
+ * * 用法: `co_await async::parallel_transform(out, f, executor, in1, in2);`
+ * * out 按连续的行带切分, 每个行带约 64K 个元素; 行内的循环是连续访问, 可以被编译器向量化.
+ */
+template <typename T, typename F, typename Executor, typename... Us>
+  requires std::is_invocable_r_v<T, F&, const Us&...>
+co_task parallel_transform(playground::matrix_view<T> out, F f, Executor& executor,
+                           playground::matrix_view<const Us>... in) {
+  if (((in.rows() != out.rows() || in.cols() != out.cols()) || ...)) {
+    throw std::invalid_argument("matrix dimensions do not match.");
+  }
+  const size_t band = std::max<size_t>((64 * 1024) / std::max<size_t>(out.cols(), 1), 1);
+  const size_t count = (out.rows() + band - 1) / band;
+  co_await parallel_for_tiles(
+      count,
+      [&](size_t i) {
+        const size_t r_end = std::min(out.rows(), (i + 1) * band);
+        for (size_t r = i * band; r < r_end; r++) {
+          T* dst = out.row(r).data();
+          const auto srcs = std::tuple{in.row(r).data()...};
+          for (size_t c = 0; c < out.cols(); c++) {
+            dst[c] = std::apply([&](const Us*... src) { return f(src[c]...); }, srcs);
+          }
+        }
+      },
+      executor);
+}
+
+/**
+ * @brief 并行求值逐元素表达式: out = expr (Awaitable)
+ * * 用法: `co_await async::parallel_assign(out, a + 2.0f * b, executor);`
+ * * 与 parallel_transform 相同地按行带切分, 每个行带内是 playground::assign 的融合遍历.
+ */
+template <typename T, playground::matrix_expression E, typename Executor>
+co_task parallel_assign(playground::matrix_view<T> out, E expr, Executor& executor) {
+  if (out.rows() != expr.rows() || out.cols() != expr.cols()) {
+    throw std::invalid_argument("matrix dimensions do not match.");
+  }
+  const size_t band = std::max<size_t>((64 * 1024) / std::max<size_t>(out.cols(), 1), 1);
+  const size_t count = (out.rows() + band - 1) / band;
+  co_await parallel_for_tiles(
+      count,
+      [&](size_t i) {
+        playground::assign_rows(out, expr, i * band, std::min(out.rows(), (i + 1) * band));
+      },
+      executor);
+}
+
+/**
+ * @brief 并行 SpMV: y = A * x, A 为 CSR (Awaitable)
+ * * 用法: `co_await async::parallel_multiply(a, x, y, executor);`
+ * * 行区间按非零元个数均分 (在 offsets 上二分), 每条线程约 4 段; 各段写 y 的不相交部分, 无需同步.
+ * * T 只从 A 推导, x / y 可以直接传 std::vector 等连续容器
+ */
+template <typename T, typename Executor>
+co_task parallel_multiply(const playground::csr_matrix<T>& a,
+                          std::type_identity_t<std::span<const T>> x,
+                          std::type_identity_t<std::span<T>> y, Executor& executor) {
+  if (x.size() != a.cols() || y.size() != a.rows()) {
+    throw std::invalid_argument("matrix and vector dimensions do not match.");
+  }
+  const auto offsets = a.offsets();
+  const size_t count = std::clamp<size_t>(4 * executor_concurrency(executor), 1,
+                                          std::max<size_t>(a.rows(), 1));
+  std::vector<size_t> bounds(count + 1, a.rows());
+  bounds[0] = 0;
+  for (size_t i = 1; i < count; i++) {
+    const size_t target = a.nnz() * i / count;
+    const auto it = std::lower_bound(offsets.begin(), offsets.end() - 1, target);
+    bounds[i] = std::max(bounds[i - 1], (size_t)(it - offsets.begin()));
+  }
+  co_await parallel_for_tiles(
+      count, [&](size_t i) { playground::multiply_rows(a, x, y, bounds[i], bounds[i + 1]); },
+      executor);
+}
+
+namespace matrix_detail {
+
+template <typename T, typename F, typename Executor>
+co_task_with<playground::Matrix2D<T>> elementwise(const playground::Matrix2D<T>& a,
+                                                  const playground::Matrix2D<T>& b, F f,
+                                                  Executor& executor) {
+  playground::Matrix2D<T> out{a.rows(), a.cols()};
+  co_await parallel_transform<T>(out.view(), f, executor, a.view(), b.view());
+  co_return out;
+}
+
+}  // namespace matrix_detail
+
+template <typename T, typename Executor>
+co_task_with<playground::Matrix2D<T>> parallel_add(const playground::Matrix2D<T>& a,
+                                                   const playground::Matrix2D<T>& b,
+                                                   Executor& executor) {
+  return matrix_detail::elementwise(a, b, std::plus<T>{}, executor);
+}
+
+template <typename T, typename Executor>
+co_task_with<playground::Matrix2D<T>> parallel_sub(const playground::Matrix2D<T>& a,
+                                                   const playground::Matrix2D<T>& b,
+                                                   Executor& executor) {
+  return matrix_detail::elementwise(a, b, std::minus<T>{}, executor);
+}
+
+template <typename T, typename Executor>
+co_task_with<playground::Matrix2D<T>> parallel_hadamard(const playground::Matrix2D<T>& a,
+                                                        const playground::Matrix2D<T>& b,
+                                                        Executor& executor) {
+  return matrix_detail::elementwise(a, b, std::multiplies<T>{}, executor);
+}
+
+}  // namespace async
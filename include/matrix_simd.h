@@ -0,0 +1,40 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace playground {
+
+/**
+ * @brief 可用的 SIMD 指令集, 运行期检测
+ * * portable 使用 16 字节的 GCC / Clang 向量扩展 (x86 上是 SSE, ARM 上是 NEON)
+ */
+enum class simd_level : uint8_t { portable, avx2, avx512 };
+
+inline simd_level detect_simd_level() {
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+  static const simd_level level = [] {
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f")) {
+      return simd_level::avx512;
+    }
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) {
+      return simd_level::avx2;
+    }
+    return simd_level::portable;
+  }();
+  return level;
+#else
+  return simd_level::portable;
+#endif
+}
+
+/**
+ * @brief GCC 不接受别名模板中依赖类型上的 vector_size, 需要放在类模板的 typedef 中
+ */
+template <typename T, size_t Bytes>
+struct simd_vec {
+  typedef T type __attribute__((vector_size(Bytes)));
+};
+
+}  // namespace playground
@@ -0,0 +1,348 @@
+#pragma once
+
+#include <algorithm>
+#include <concepts>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <initializer_list>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+
+#include "matrix.h"
+#include "matrix_simd.h"
+
+namespace playground {
+
+/**
+ * @brief 可以用向量寄存器按位搬运的元素类型
+ */
+template <typename T>
+concept simd_transposable = std::is_trivially_copyable_v<T> &&
+                            (sizeof(T) == 1 || sizeof(T) == 2 || sizeof(T) == 4 || sizeof(T) == 8);
+
+/**
+ * @brief 转置的块内核, 只搬运比特, 不关心元素的具体类型
+ * * block[r]: 把 src 的 r x 8 小块 (行跨度 ls) 转置写到 dst 的 8 x r 小块 (行跨度 ld), r = 1..8
+ * * swap: p 与 q 处的两个 8 x 8 小块互换并各自转置, 用于原地转置的非对角块
+ */
+template <typename T>
+struct transpose_kernels {
+  using block_fn = void (*)(const T* src, size_t ls, T* dst, size_t ld);
+  using swap_fn = void (*)(T* p, T* q, size_t ld);
+
+  block_fn block[9];
+  swap_fn swap;
+};
+
+namespace transpose_detail {
+
+/**
+ * @brief 递归切分到 leaf x leaf 以内再按 8 x 8 小块处理; 两块合计 2 * 32 * 32 * sizeof(T) 字节留在 L1
+ */
+constexpr size_t leaf = 32;
+
+/**
+ * @brief 取一半并向上取整到 8 的倍数, 使切分后的子块仍由完整的 8 x 8 小块组成
+ */
+constexpr size_t split_point(size_t n) noexcept {
+  return (n / 2 + 7) / 8 * 8;
+}
+
+template <size_t Size>
+using lane_t = std::conditional_t<
+    Size == 1, uint8_t,
+    std::conditional_t<Size == 2, uint16_t, std::conditional_t<Size == 4, uint32_t, uint64_t>>>;
+
+/**
+ * @brief 寄存器中 8 x 8 的转置: 依次以 4 / 2 / 1 为距离, 交换行号与列号的对应比特
+ */
+template <typename V>
+[[gnu::always_inline]] inline void transpose8(V (&r)[8]) {
+#pragma GCC unroll 4
+  for (size_t i = 0; i < 4; i++) {
+    const V a = r[i];
+    const V b = r[i + 4];
+    r[i] = __builtin_shufflevector(a, b, 0, 1, 2, 3, 8, 9, 10, 11);
+    r[i + 4] = __builtin_shufflevector(a, b, 4, 5, 6, 7, 12, 13, 14, 15);
+  }
+#pragma GCC unroll 4
+  for (size_t i : {0, 1, 4, 5}) {
+    const V a = r[i];
+    const V b = r[i + 2];
+    r[i] = __builtin_shufflevector(a, b, 0, 1, 8, 9, 4, 5, 12, 13);
+    r[i + 2] = __builtin_shufflevector(a, b, 2, 3, 10, 11, 6, 7, 14, 15);
+  }
+#pragma GCC unroll 4
+  for (size_t i = 0; i < 8; i += 2) {
+    const V a = r[i];
+    const V b = r[i + 1];
+    r[i] = __builtin_shufflevector(a, b, 0, 8, 2, 10, 4, 12, 6, 14);
+    r[i + 1] = __builtin_shufflevector(a, b, 1, 9, 3, 11, 5, 13, 7, 15);
+  }
+}
+
+/**
+ * @brief 块内核本体, 与 gemm 的微内核一样以 always_inline 展开进各个指令集的包装函数中;
+ * 不足 8 行的部分在寄存器中补 0, 写回时只写前 R 个元素
+ */
+template <typename T, size_t R>
+[[gnu::always_inline]] inline void block_kernel(const T* src, size_t ls, T* dst, size_t ld) {
+  using vec_t = typename simd_vec<lane_t<sizeof(T)>, 8 * sizeof(T)>::type;
+  vec_t r[8]{};
+#pragma GCC unroll 8
+  for (size_t i = 0; i < R; i++) {
+    std::memcpy(&r[i], src + i * ls, sizeof(vec_t));
+  }
+  transpose8(r);
+#pragma GCC unroll 8
+  for (size_t j = 0; j < 8; j++) {
+    std::memcpy(dst + j * ld, &r[j], R * sizeof(T));
+  }
+}
+
+template <typename T>
+[[gnu::always_inline]] inline void swap_kernel(T* p, T* q, size_t ld) {
+  using vec_t = typename simd_vec<lane_t<sizeof(T)>, 8 * sizeof(T)>::type;
+  vec_t a[8];
+  vec_t b[8];
+#pragma GCC unroll 8
+  for (size_t i = 0; i < 8; i++) {
+    std::memcpy(&a[i], p + i * ld, sizeof(vec_t));
+    std::memcpy(&b[i], q + i * ld, sizeof(vec_t));
+  }
+  transpose8(a);
+  transpose8(b);
+#pragma GCC unroll 8
+  for (size_t i = 0; i < 8; i++) {
+    std::memcpy(q + i * ld, &a[i], sizeof(vec_t));
+    std::memcpy(p + i * ld, &b[i], sizeof(vec_t));
+  }
+}
+
+template <typename T, size_t R>
+void block_portable(const T* src, size_t ls, T* dst, size_t ld) {
+  block_kernel<T, R>(src, ls, dst, ld);
+}
+
+template <typename T>
+void swap_portable(T* p, T* q, size_t ld) {
+  swap_kernel<T>(p, q, ld);
+}
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+template <typename T, size_t R>
+[[gnu::target("avx2")]] void block_avx2(const T* src, size_t ls, T* dst, size_t ld) {
+  block_kernel<T, R>(src, ls, dst, ld);
+}
+
+template <typename T>
+[[gnu::target("avx2")]] void swap_avx2(T* p, T* q, size_t ld) {
+  swap_kernel<T>(p, q, ld);
+}
+
+template <typename T, size_t R>
+[[gnu::target("avx512f")]] void block_avx512(const T* src, size_t ls, T* dst, size_t ld) {
+  block_kernel<T, R>(src, ls, dst, ld);
+}
+
+template <typename T>
+[[gnu::target("avx512f")]] void swap_avx512(T* p, T* q, size_t ld) {
+  swap_kernel<T>(p, q, ld);
+}
+#endif
+
+/**
+ * @brief 叶子: 完整的 8 列一组交给块内核 (不足 8 行时用 block[rows % 8]), 剩余的列逐元素复制
+ */
+template <typename T>
+void transpose_leaf(const T* src, size_t ls, T* dst, size_t ld, size_t rows, size_t cols,
+                    const transpose_kernels<T>* kernels) {
+  size_t full_cols = 0;
+  if (kernels != nullptr) {
+    full_cols = cols / 8 * 8;
+    for (size_t i = 0; i < rows; i += 8) {
+      const auto block = kernels->block[std::min<size_t>(8, rows - i)];
+      for (size_t j = 0; j < full_cols; j += 8) {
+        block(src + i * ls + j, ls, dst + j * ld + i, ld);
+      }
+    }
+  }
+  for (size_t i = 0; i < rows; i++) {
+    for (size_t j = full_cols; j < cols; j++) {
+      dst[j * ld + i] = src[i * ls + j];
+    }
+  }
+}
+
+/**
+ * @brief 缓存无关 (cache-oblivious) 的非原地转置: 沿较长的一边对半切分, 直到子块不超过 leaf x leaf,
+ * 子块的读写都落在少量 cache line 与页内, 不依赖具体的缓存大小
+ */
+template <typename T>
+void transpose_recursive(const T* src, size_t ls, T* dst, size_t ld, size_t rows, size_t cols,
+                         const transpose_kernels<T>* kernels) {
+  while (rows > leaf || cols > leaf) {
+    if (rows >= cols) {
+      const size_t h = split_point(rows);
+      transpose_recursive(src, ls, dst, ld, h, cols, kernels);
+      src += h * ls;
+      dst += h;
+      rows -= h;
+    } else {
+      const size_t w = split_point(cols);
+      transpose_recursive(src, ls, dst, ld, rows, w, kernels);
+      src += w;
+      dst += w * ld;
+      cols -= w;
+    }
+  }
+  transpose_leaf(src, ls, dst, ld, rows, cols, kernels);
+}
+
+/**
+ * @brief b (rows x cols) 与 c (cols x rows) 互换并各自转置: b = c^T, c = b^T
+ */
+template <typename T>
+void swap_transpose_recursive(T* b, T* c, size_t ld, size_t rows, size_t cols,
+                              const transpose_kernels<T>* kernels) {
+  while (rows > leaf || cols > leaf) {
+    if (rows >= cols) {
+      const size_t h = split_point(rows);
+      swap_transpose_recursive(b, c, ld, h, cols, kernels);
+      b += h * ld;
+      c += h;
+      rows -= h;
+    } else {
+      const size_t w = split_point(cols);
+      swap_transpose_recursive(b, c, ld, rows, w, kernels);
+      b += w;
+      c += w * ld;
+      cols -= w;
+    }
+  }
+  const size_t full_rows = kernels != nullptr ? rows / 8 * 8 : 0;
+  const size_t full_cols = kernels != nullptr ? cols / 8 * 8 : 0;
+  for (size_t i = 0; i < full_rows; i += 8) {
+    for (size_t j = 0; j < full_cols; j += 8) {
+      kernels->swap(b + i * ld + j, c + j * ld + i, ld);
+    }
+  }
+  for (size_t i = 0; i < rows; i++) {
+    for (size_t j = i < full_rows ? full_cols : 0; j < cols; j++) {
+      std::swap(b[i * ld + j], c[j * ld + i]);
+    }
+  }
+}
+
+/**
+ * @brief 方阵原地转置: 两个对角子块递归原地转置, 两个非对角子块互换转置
+ */
+template <typename T>
+void transpose_in_place_recursive(T* p, size_t n, size_t ld, const transpose_kernels<T>* kernels) {
+  if (n > leaf) {
+    const size_t h = split_point(n);
+    transpose_in_place_recursive(p, h, ld, kernels);
+    transpose_in_place_recursive(p + h * ld + h, n - h, ld, kernels);
+    swap_transpose_recursive(p + h, p + h * ld, ld, h, n - h, kernels);
+    return;
+  }
+  const size_t full = kernels != nullptr ? n / 8 * 8 : 0;
+  for (size_t i = 0; i < full; i += 8) {
+    kernels->block[8](p + i * ld + i, ld, p + i * ld + i, ld);  // 先全部读入寄存器, 可以原地写回
+    for (size_t j = i + 8; j < full; j += 8) {
+      kernels->swap(p + i * ld + j, p + j * ld + i, ld);
+    }
+  }
+  for (size_t i = 0; i < n; i++) {
+    for (size_t j = std::max(i + 1, i < full ? full : 0); j < n; j++) {
+      std::swap(p[i * ld + j], p[j * ld + i]);
+    }
+  }
+}
+
+}  // namespace transpose_detail
+
+/**
+ * @brief 指定指令集的转置块内核; 元素类型不能按位搬运时返回 nullptr, 退回到逐元素复制
+ */
+template <typename T>
+const transpose_kernels<T>* transpose_kernels_for(simd_level level) {
+  if constexpr (!simd_transposable<T>) {
+    return nullptr;
+  } else {
+    using namespace transpose_detail;
+    auto make = []<size_t... R>(std::index_sequence<R...>, auto block, auto swap) {
+      transpose_kernels<T> kernels{};
+      ((kernels.block[R + 1] = block.template operator()<R + 1>()), ...);
+      kernels.swap = swap;
+      return kernels;
+    };
+    static const transpose_kernels<T> portable = make(
+        std::make_index_sequence<8>{}, []<size_t R>() { return &block_portable<T, R>; },
+        &swap_portable<T>);
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+    static const transpose_kernels<T> avx2 = make(
+        std::make_index_sequence<8>{}, []<size_t R>() { return &block_avx2<T, R>; },
+        &swap_avx2<T>);
+    static const transpose_kernels<T> avx512 = make(
+        std::make_index_sequence<8>{}, []<size_t R>() { return &block_avx512<T, R>; },
+        &swap_avx512<T>);
+    level = std::min(level, detect_simd_level());
+    if (level == simd_level::avx512) {
+      return &avx512;
+    }
+    if (level == simd_level::avx2) {
+      return &avx2;
+    }
+#endif
+    return &portable;
+  }
+}
+
+/**
+ * @brief 非原地转置: dst = src^T
+ * * src / dst 可以是任意的子矩阵视图, dst 必须是 cols x rows 且不能与 src 重叠
+ */
+template <typename U, typename T>
+  requires std::same_as<std::remove_const_t<U>, T>
+void transpose(matrix_view<U> src, matrix_view<T> dst) {
+  if (dst.rows() != src.cols() || dst.cols() != src.rows()) {
+    throw std::invalid_argument("matrix dimensions do not match.");
+  }
+  transpose_detail::transpose_recursive<T>(src.data(), src.stride(), dst.data(), dst.stride(),
+                                           src.rows(), src.cols(),
+                                           transpose_kernels_for<T>(detect_simd_level()));
+}
+
+template <typename T>
+Matrix2D<std::remove_const_t<T>> transpose(matrix_view<T> src) {
+  Matrix2D<std::remove_const_t<T>> dst{src.cols(), src.rows()};
+  transpose(src, dst.view());
+  return dst;
+}
+
+template <typename T>
+Matrix2D<T> transpose(const Matrix2D<T>& m) {
+  return transpose(m.view());
+}
+
+/**
+ * @brief 方阵原地转置, 非方阵抛出 std::invalid_argument
+ */
+template <typename T>
+void transpose_in_place(matrix_view<T> m) {
+  if (m.rows() != m.cols()) {
+    throw std::invalid_argument("in-place transpose requires a square matrix.");
+  }
+  transpose_detail::transpose_in_place_recursive(m.data(), m.rows(), m.stride(),
+                                                 transpose_kernels_for<T>(detect_simd_level()));
+}
+
+template <typename T>
+void transpose_in_place(Matrix2D<T>& m) {
+  transpose_in_place(m.view());
+}
+
+}  // namespace playground
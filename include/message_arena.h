@@ -0,0 +1,294 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <memory_resource>
+#include <mutex>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace msg {
+
+class arena_pool;
+
+/**
+ * @brief 一段消息负载共用的单调分配区 (monotonic arena)
+ * * 同一批消息的 string / vector 负载都从这里分配, 分配只是移动指针; 所有引用都释放后
+ * 整块归还所属的 arena_pool 复用, 不逐个 free.
+ * * 引用计数侵入在 arena 内, arena_ref 拷贝一次只是一个原子加, 不分配内存.
+ * @note 内部的 monotonic_buffer_resource 不加锁: 只能由填充这批消息的线程分配,
+ *       之后的其他线程只读取负载、释放引用
+ */
+class message_arena {
+  friend class arena_pool;
+  friend class arena_ref;
+
+  std::atomic<uint32_t> refs{0};
+  std::shared_ptr<arena_pool> owner;  // 仅在使用中持有, 空闲时为空, 避免与 pool 循环引用
+  std::pmr::memory_resource* upstream;
+  std::byte* buffer;
+  size_t capacity;
+  std::pmr::monotonic_buffer_resource resource;
+
+  message_arena(size_t capacity, std::pmr::memory_resource* upstream)
+      : upstream{upstream},
+        buffer{static_cast<std::byte*>(upstream->allocate(capacity, alignof(std::max_align_t)))},
+        capacity{capacity},
+        resource{buffer, capacity, upstream} {}
+
+  void release() noexcept;
+
+ public:
+  message_arena(const message_arena&) = delete;
+  message_arena& operator=(const message_arena&) = delete;
+
+  ~message_arena();
+
+  std::pmr::polymorphic_allocator<> allocator() noexcept {
+    return &resource;
+  }
+};
+
+/**
+ * @brief message_arena 的侵入式智能指针
+ */
+class arena_ref {
+  message_arena* ptr{nullptr};
+
+ public:
+  arena_ref() noexcept = default;
+
+  explicit arena_ref(message_arena* p) noexcept : ptr{p} {
+    if (ptr != nullptr) {
+      ptr->refs.fetch_add(1, std::memory_order_relaxed);
+    }
+  }
+
+  arena_ref(const arena_ref& other) noexcept : arena_ref{other.ptr} {}
+
+  arena_ref(arena_ref&& other) noexcept : ptr{std::exchange(other.ptr, nullptr)} {}
+
+  arena_ref& operator=(arena_ref other) noexcept {
+    std::swap(ptr, other.ptr);
+    return *this;
+  }
+
+  ~arena_ref() {
+    if (ptr != nullptr) {
+      ptr->release();
+    }
+  }
+
+  message_arena& operator*() const noexcept {
+    return *ptr;
+  }
+
+  message_arena* operator->() const noexcept {
+    return ptr;
+  }
+
+  explicit operator bool() const noexcept {
+    return ptr != nullptr;
+  }
+};
+
+/**
+ * @brief message_arena 的对象池, 约定每个写入线程一个 (`arena_pool::local()`)
+ * * acquire 只由所属线程调用; arena 可以在任意线程 (通常是读取方) 释放, 释放时加锁放回空闲表,
+ * 每批消息只有一次.
+ * * 使用中的 arena 持有 pool 的 shared_ptr, 因此线程退出后仍在传递中的消息依然有效.
+ */
+class arena_pool : public std::enable_shared_from_this<arena_pool> {
+  friend class message_arena;
+
+  const size_t block_bytes;
+  std::pmr::memory_resource* const upstream;
+  std::mutex mutex;
+  std::vector<message_arena*> free_list;
+  bool closed{false};
+
+  struct private_tag {};
+
+  void recycle(message_arena* arena) noexcept {
+    arena->resource.release();  // 回到初始 buffer, 归还溢出到 upstream 的部分
+    {
+      std::lock_guard lock{mutex};
+      if (!closed) {
+        free_list.push_back(arena);
+        return;
+      }
+    }
+    delete arena;
+  }
+
+ public:
+  arena_pool(private_tag, size_t block_bytes, std::pmr::memory_resource* upstream)
+      : block_bytes{block_bytes}, upstream{upstream} {}
+
+  /**
+   * @param block_bytes 每个 arena 的初始 buffer 大小, 超出部分向 upstream 申请
+   */
+  static std::shared_ptr<arena_pool> create(
+      size_t block_bytes = (size_t)64 << 10,
+      std::pmr::memory_resource* upstream = std::pmr::new_delete_resource()) {
+    return std::make_shared<arena_pool>(private_tag{}, block_bytes, upstream);
+  }
+
+  /**
+   * @brief 当前线程的 pool
+   */
+  static arena_pool& local() {
+    thread_local std::shared_ptr<arena_pool> pool = create();
+    return *pool;
+  }
+
+  arena_pool(const arena_pool&) = delete;
+  arena_pool& operator=(const arena_pool&) = delete;
+
+  ~arena_pool() {
+    for (message_arena* arena : free_list) {
+      delete arena;
+    }
+  }
+
+  /**
+   * @brief 取一个空的 arena, 空闲表为空时新建
+   */
+  arena_ref acquire() {
+    {
+      std::lock_guard lock{mutex};
+      if (!free_list.empty()) {
+        message_arena* arena = free_list.back();
+        free_list.pop_back();
+        arena->owner = shared_from_this();
+        return arena_ref{arena};
+      }
+    }
+    auto* arena = new message_arena{block_bytes, upstream};
+    arena->owner = shared_from_this();
+    return arena_ref{arena};
+  }
+
+  /**
+   * @brief 释放空闲的 arena, 之后归还的 arena 直接销毁
+   */
+  void close() {
+    std::vector<message_arena*> arenas;
+    {
+      std::lock_guard lock{mutex};
+      closed = true;
+      arenas.swap(free_list);
+    }
+    for (message_arena* arena : arenas) {
+      delete arena;
+    }
+  }
+
+  size_t idle() {
+    std::lock_guard lock{mutex};
+    return free_list.size();
+  }
+};
+
+/**
+ * @note recycle 之后 arena 可能已被其他线程重新取走, 只能再访问局部的 pool;
+ *       pool 的最后一个引用在这里释放时, pool 连同空闲的 arena 一起销毁
+ */
+inline void message_arena::release() noexcept {
+  if (refs.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+    auto pool = std::move(owner);
+    pool->recycle(this);
+  }
+}
+
+inline message_arena::~message_arena() {
+  resource.release();
+  upstream->deallocate(buffer, capacity, alignof(std::max_align_t));
+}
+
+/**
+ * @brief 分配在 message_arena 中的负载, 作为 message 的 variant 分支使用
+ * * 例: `msg::pooled<std::pmr::string>{arena, "text"}`, T 按 uses-allocator 构造使用 arena 的分配器.
+ * * 持有 arena 的引用, 负载先于引用析构; 移动只转移指针, 不复制负载.
+ * * 拷贝 (构造 / 赋值) 可能发生在任意线程, 而 arena 只允许填充它的线程分配, 因此副本不属于任何
+ * arena, 负载使用默认的 memory_resource; 需要放入指定 arena 时用 `copy_to(arena)`.
+ * * 默认构造的 pooled 不属于任何 arena, 负载使用默认的 memory_resource.
+ */
+template <typename T>
+  requires std::uses_allocator_v<T, std::pmr::polymorphic_allocator<>>
+class pooled {
+  arena_ref arena;
+  T value;
+
+  static T make(const arena_ref& arena, auto&&... args) {
+    return arena ? std::make_obj_using_allocator<T>(arena->allocator(),
+                                                    std::forward<decltype(args)>(args)...)
+                 : T(std::forward<decltype(args)>(args)...);
+  }
+
+ public:
+  pooled() = default;
+
+  template <typename... Args>
+  explicit pooled(arena_ref arena, Args&&... args)
+      : arena{std::move(arena)}, value{make(this->arena, std::forward<Args>(args)...)} {}
+
+  pooled(const pooled& other) : value{make(arena_ref{}, other.value)} {}
+
+  /**
+   * @brief 移动构造时 pmr 容器连同分配器一起转移
+   */
+  pooled(pooled&& other) noexcept : arena{other.arena}, value{std::move(other.value)} {}
+
+  /**
+   * @brief pmr 容器赋值不传播分配器, 因此赋值时按默认的 memory_resource 重建负载并脱离原 arena
+   */
+  pooled& operator=(const pooled& other) {
+    if (this != &other) {
+      T copy = make(arena_ref{}, other.value);
+      std::destroy_at(&value);
+      std::construct_at(&value, std::move(copy));
+      arena = arena_ref{};
+    }
+    return *this;
+  }
+
+  pooled& operator=(pooled&& other) noexcept {
+    if (this != &other) {
+      std::destroy_at(&value);
+      std::construct_at(&value, std::move(other.value));
+      arena = other.arena;
+    }
+    return *this;
+  }
+
+  ~pooled() = default;
+
+  /**
+   * @brief 把负载拷贝到 target 中, 调用方须是正在填充 target 的线程
+   */
+  pooled copy_to(arena_ref target) const {
+    return pooled{std::move(target), value};
+  }
+
+  T& operator*() noexcept {
+    return value;
+  }
+
+  const T& operator*() const noexcept {
+    return value;
+  }
+
+  T* operator->() noexcept {
+    return &value;
+  }
+
+  const T* operator->() const noexcept {
+    return &value;
+  }
+};
+
+}  // namespace msg
@@ -0,0 +1,221 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <limits>
+#include <optional>
+#include <ranges>
+#include <span>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <variant>
+#include <vector>
+
+#include "message.h"
+
+namespace msg {
+
+template <typename V>
+struct payload_columns_;
+
+template <typename... Ts>
+struct payload_columns_<std::variant<Ts...>> {
+  using type = std::tuple<std::vector<Ts>...>;
+};
+
+/**
+ * @brief 按列存储的一批 message<V> (structure of arrays)
+ * * 列: 每行的分支下标 indices、serial_numbers、timestamps (以 duration 计数存储, 没有时间戳为
+ * no_timestamp), 以及每个分支各自一列负载和该分支所在的行号.
+ * * `column<double>()` 返回连续的 std::span<double>, 只扫描某一类负载时不会跨过其他字段,
+ * 可以直接交给编译器向量化; `rows<double>()[k]` 是该列第 k 个元素所在的行, 用于取对应的表头.
+ * * 与 AoS 的转换: `push_back(msg)` / `append(range)` 拆分写入, `to_messages(out)` 按原顺序还原;
+ * 提供 value_type 与 push_back, 因此可以作为 `std::back_inserter` 的目标, 例如
+ * `stream.read_many(std::back_inserter(batch), 256)`.
+ * @note monostate 没有负载列, 只记在 indices 中
+ */
+template <valid_msg_variant V>
+class message_batch {
+ public:
+  using value_type = message<V>;
+  using serial_number_t = typename value_type::serial_number_t;
+  using timestamp_t = typename value_type::timestamp_t;
+  using ticks_t = typename timestamp_t::rep;
+
+  static constexpr ticks_t no_timestamp = std::numeric_limits<ticks_t>::min();
+
+ private:
+  static constexpr size_t size_v = std::variant_size_v<V>;
+
+  std::vector<uint8_t> indices;
+  std::vector<serial_number_t> serials;
+  std::vector<ticks_t> ticks;
+  typename payload_columns_<V>::type payloads;
+  std::array<std::vector<uint32_t>, size_v> row_columns;
+
+  template <typename T>
+  static constexpr size_t index_of = type_in_variant_<T, V>::index;
+
+  template <size_t I, typename D>
+  void push_payload(D&& data) {
+    if constexpr (I != 0) {
+      std::get<I>(payloads).push_back(std::get<I>(std::forward<D>(data)));
+    }
+  }
+
+  template <typename D>
+  void push_data(D&& data) {
+    [&]<size_t... Is>(std::index_sequence<Is...>) {
+      const size_t index = data.index();
+      (void)((index == Is ? (push_payload<Is>(std::forward<D>(data)), true) : false) || ...);
+    }(std::make_index_sequence<size_v>{});
+  }
+
+  template <size_t I>
+  void take_payload(V& data, size_t slot) const {
+    if constexpr (I == 0) {
+      data.template emplace<0>();
+    } else {
+      data.template emplace<I>(std::get<I>(payloads)[slot]);
+    }
+  }
+
+ public:
+  static_assert(size_v <= 256, "indices are stored as uint8_t");
+
+  message_batch() = default;
+
+  template <std::ranges::input_range R>
+    requires std::convertible_to<std::ranges::range_reference_t<R>, const value_type&>
+  explicit message_batch(R&& range) {
+    append(std::forward<R>(range));
+  }
+
+  void reserve(size_t n) {
+    indices.reserve(n);
+    serials.reserve(n);
+    ticks.reserve(n);
+  }
+
+  template <typename M>
+    requires std::same_as<std::remove_cvref_t<M>, value_type>
+  void push_back(M&& msg) {
+    const size_t index = msg.data.index();
+    row_columns[index].push_back((uint32_t)indices.size());
+    indices.push_back((uint8_t)index);
+    serials.push_back(msg.serial_number);
+    ticks.push_back(msg.timestamp ? msg.timestamp->time_since_epoch().count() : no_timestamp);
+    push_data(std::forward<M>(msg).data);
+  }
+
+  template <std::ranges::input_range R>
+    requires std::convertible_to<std::ranges::range_reference_t<R>, const value_type&>
+  void append(R&& range) {
+    if constexpr (std::ranges::sized_range<R>) {
+      reserve(size() + std::ranges::size(range));
+    }
+    for (auto&& msg : range) {
+      push_back(std::forward<decltype(msg)>(msg));
+    }
+  }
+
+  /**
+   * @brief 按原顺序还原为 message<V>, 写入 out (负载被复制, batch 不变)
+   */
+  template <std::output_iterator<value_type&&> Out>
+  Out to_messages(Out out) const {
+    std::array<size_t, size_v> cursor{};
+    for (size_t i = 0; i < size(); i++) {
+      value_type msg;
+      const size_t index = indices[i];
+      [&]<size_t... Is>(std::index_sequence<Is...>) {
+        (void)((index == Is ? (take_payload<Is>(msg.data, cursor[Is]++), true) : false) || ...);
+      }(std::make_index_sequence<size_v>{});
+      msg.serial_number = serials[i];
+      if (ticks[i] != no_timestamp) {
+        msg.timestamp = timestamp_t{typename timestamp_t::duration{ticks[i]}};
+      }
+      *out++ = std::move(msg);
+    }
+    return out;
+  }
+
+  std::vector<value_type> to_messages() const {
+    std::vector<value_type> messages;
+    messages.reserve(size());
+    to_messages(std::back_inserter(messages));
+    return messages;
+  }
+
+  template <type_in_variant<V> T>
+    requires(!std::is_same_v<T, std::monostate>)
+  std::span<T> column() noexcept {
+    return std::get<index_of<T>>(payloads);
+  }
+
+  template <type_in_variant<V> T>
+    requires(!std::is_same_v<T, std::monostate>)
+  std::span<const T> column() const noexcept {
+    return std::get<index_of<T>>(payloads);
+  }
+
+  /**
+   * @return 分支 T 的各条消息所在的行号, 与 column<T>() 一一对应
+   */
+  template <type_in_variant<V> T>
+  std::span<const uint32_t> rows() const noexcept {
+    return row_columns[index_of<T>];
+  }
+
+  std::span<const uint8_t> index_column() const noexcept {
+    return indices;
+  }
+
+  std::span<const serial_number_t> serial_numbers() const noexcept {
+    return serials;
+  }
+
+  /**
+   * @return 各行时间戳的 duration 计数, 没有时间戳的行为 no_timestamp
+   */
+  std::span<const ticks_t> timestamps() const noexcept {
+    return ticks;
+  }
+
+  std::optional<timestamp_t> timestamp(size_t row) const noexcept {
+    return ticks[row] == no_timestamp
+               ? std::nullopt
+               : std::optional{timestamp_t{typename timestamp_t::duration{ticks[row]}}};
+  }
+
+  template <type_in_variant<V> T>
+  size_t count() const noexcept {
+    return row_columns[index_of<T>].size();
+  }
+
+  size_t size() const noexcept {
+    return indices.size();
+  }
+
+  bool empty() const noexcept {
+    return indices.empty();
+  }
+
+  /**
+   * @brief 清空所有列, 保留已分配的容量
+   */
+  void clear() noexcept {
+    indices.clear();
+    serials.clear();
+    ticks.clear();
+    std::apply([](auto&... columns) { (columns.clear(), ...); }, payloads);
+    for (auto& rows : row_columns) {
+      rows.clear();
+    }
+  }
+};
+
+}  // namespace msg
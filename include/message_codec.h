@@ -0,0 +1,396 @@
+#pragma once
+
+#include <array>
+#include <bit>
+#include <chrono>
+#include <concepts>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <optional>
+#include <span>
+#include <string>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <variant>
+#include <vector>
+
+#include "message.h"
+
+namespace msg {
+
+/**
+ * @brief 写游标, 调用方保证空间足够 (先用 encoded_size 检查)
+ */
+struct byte_writer {
+  std::byte* pos;
+
+  void put(const void* data, size_t n) noexcept {
+    std::memcpy(pos, data, n);
+    pos += n;
+  }
+
+  void varint(uint64_t value) noexcept {
+    while (value >= 0x80) {
+      *pos++ = std::byte(value | 0x80);
+      value >>= 7;
+    }
+    *pos++ = std::byte(value);
+  }
+};
+
+/**
+ * @brief 带边界检查的读游标, 读取失败 (截断或格式错误) 时返回 false
+ */
+struct byte_reader {
+  const std::byte* pos;
+  const std::byte* end;
+
+  size_t remaining() const noexcept {
+    return end - pos;
+  }
+
+  bool get(void* data, size_t n) noexcept {
+    if (remaining() < n) {
+      return false;
+    }
+    std::memcpy(data, pos, n);
+    pos += n;
+    return true;
+  }
+
+  bool varint(uint64_t& value) noexcept {
+    value = 0;
+    for (int shift = 0; shift < 64 && pos != end; shift += 7) {
+      const auto byte = std::to_integer<uint64_t>(*pos++);
+      value |= (byte & 0x7f) << shift;
+      if (byte < 0x80) {
+        return true;
+      }
+    }
+    return false;
+  }
+};
+
+constexpr size_t varint_size(uint64_t value) noexcept {
+  return value == 0 ? 1 : (std::bit_width(value) + 6) / 7;
+}
+
+constexpr uint64_t zigzag(int64_t value) noexcept {
+  return (static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63);
+}
+
+constexpr int64_t unzigzag(uint64_t value) noexcept {
+  return static_cast<int64_t>(value >> 1) ^ -static_cast<int64_t>(value & 1);
+}
+
+/**
+ * @brief 单个字段的编解码, 按类型在编译期选择:
+ * * trivially copyable: 直接 memcpy (空类型不占字节)
+ * * std::basic_string / std::vector: varint 长度前缀 + 元素
+ * * 提供 `codec_fields()` (返回 std::tie(...)) 的类型: 依次编码各字段
+ */
+template <typename T>
+struct field_codec;
+
+template <typename T>
+concept codec_field = requires(const T& value, T& out, byte_writer& writer, byte_reader& reader) {
+  { field_codec<T>::size(value) } -> std::same_as<size_t>;
+  field_codec<T>::write(writer, value);
+  { field_codec<T>::read(reader, out) } -> std::same_as<bool>;
+};
+
+template <typename T>
+concept has_codec_fields = requires(T& value, const T& cvalue) {
+  value.codec_fields();
+  cvalue.codec_fields();
+};
+
+template <typename T>
+  requires std::is_trivially_copyable_v<T>
+struct field_codec<T> {
+  static constexpr size_t size(const T&) noexcept {
+    return std::is_empty_v<T> ? 0 : sizeof(T);
+  }
+
+  static void write(byte_writer& writer, const T& value) noexcept {
+    if constexpr (!std::is_empty_v<T>) {
+      writer.put(&value, sizeof(T));
+    }
+  }
+
+  static bool read(byte_reader& reader, T& value) noexcept {
+    if constexpr (std::is_empty_v<T>) {
+      return true;
+    } else {
+      return reader.get(&value, sizeof(T));
+    }
+  }
+};
+
+template <typename T, typename A>
+  requires codec_field<T>
+struct field_codec<std::vector<T, A>> {
+  static size_t size(const std::vector<T, A>& value) {
+    size_t n = varint_size(value.size());
+    if constexpr (std::is_trivially_copyable_v<T>) {
+      n += value.size() * field_codec<T>::size(T{});
+    } else {
+      for (const auto& item : value) {
+        n += field_codec<T>::size(item);
+      }
+    }
+    return n;
+  }
+
+  static void write(byte_writer& writer, const std::vector<T, A>& value) {
+    writer.varint(value.size());
+    if constexpr (std::is_trivially_copyable_v<T>) {
+      if constexpr (!std::is_empty_v<T>) {
+        writer.put(value.data(), value.size() * sizeof(T));
+      }
+    } else {
+      for (const auto& item : value) {
+        field_codec<T>::write(writer, item);
+      }
+    }
+  }
+
+  static bool read(byte_reader& reader, std::vector<T, A>& value) {
+    uint64_t n;
+    if (!reader.varint(n)) {
+      return false;
+    }
+    if constexpr (std::is_trivially_copyable_v<T> && !std::is_empty_v<T>) {
+      if (n > reader.remaining() / sizeof(T)) {
+        return false;
+      }
+      value.resize(n);
+      return reader.get(value.data(), n * sizeof(T));
+    } else {
+      if (!std::is_empty_v<T> && n > reader.remaining()) {
+        return false;  // 每个元素至少 1 字节, 防止按损坏的长度分配
+      }
+      value.resize(n);
+      for (auto& item : value) {
+        if (!field_codec<T>::read(reader, item)) {
+          return false;
+        }
+      }
+      return true;
+    }
+  }
+};
+
+template <typename C, typename Traits, typename A>
+  requires std::is_trivially_copyable_v<C>
+struct field_codec<std::basic_string<C, Traits, A>> {
+  using string_t = std::basic_string<C, Traits, A>;
+
+  static size_t size(const string_t& value) noexcept {
+    return varint_size(value.size()) + value.size() * sizeof(C);
+  }
+
+  static void write(byte_writer& writer, const string_t& value) noexcept {
+    writer.varint(value.size());
+    writer.put(value.data(), value.size() * sizeof(C));
+  }
+
+  static bool read(byte_reader& reader, string_t& value) {
+    uint64_t n;
+    if (!reader.varint(n) || n > reader.remaining() / sizeof(C)) {
+      return false;
+    }
+    value.resize(n);
+    return reader.get(value.data(), n * sizeof(C));
+  }
+};
+
+template <typename T>
+  requires(!std::is_trivially_copyable_v<T>) && has_codec_fields<T>
+struct field_codec<T> {
+  static size_t size(const T& value) {
+    return std::apply(
+        [](const auto&... fields) {
+          return (size_t{0} + ... +
+                  field_codec<std::remove_cvref_t<decltype(fields)>>::size(fields));
+        },
+        value.codec_fields());
+  }
+
+  static void write(byte_writer& writer, const T& value) {
+    std::apply(
+        [&](const auto&... fields) {
+          (field_codec<std::remove_cvref_t<decltype(fields)>>::write(writer, fields), ...);
+        },
+        value.codec_fields());
+  }
+
+  static bool read(byte_reader& reader, T& value) {
+    return std::apply(
+        [&](auto&... fields) {
+          return (true && ... &&
+                  field_codec<std::remove_cvref_t<decltype(fields)>>::read(reader, fields));
+        },
+        value.codec_fields());
+  }
+};
+
+template <typename V>
+struct codec_variant_ : public std::false_type {};
+
+template <typename... Ts>
+struct codec_variant_<std::variant<Ts...>>
+    : public std::bool_constant<(true && ... &&
+                                 (codec_field<Ts> && std::is_default_constructible_v<Ts>))> {};
+
+/**
+ * @brief 所有分支都可编解码且不超过 128 个
+ */
+template <typename V>
+concept codec_variant =
+    valid_msg_variant<V> && codec_variant_<V>::value && (std::variant_size_v<V> <= 128);
+
+/**
+ * @brief message<V> 的紧凑二进制编码, 编解码函数按分支在编译期生成
+ * * 格式: [index | has_timestamp << 7] (1 字节) + varint serial_number
+ *   + zigzag varint 时间戳增量 (仅当有时间戳) + payload.
+ * * 时间戳是相对于同一方向上一条带时间戳消息的增量, 因此编码和解码需按相同顺序进行;
+ *   一个 codec 对象的编码状态和解码状态相互独立, 可以同时作为一条连接两端的编码器和解码器.
+ * * trivially copyable 的分支直接 memcpy, 解码时不分配内存; 解码到已持有同一分支的消息时
+ *   复用其中的 string / vector.
+ * @note 编码按本机字节序和布局, 只适用于同构的两端
+ */
+template <codec_variant V>
+class message_codec {
+ public:
+  using msg_t = message<V>;
+  using timestamp_t = typename msg_t::timestamp_t;
+
+ private:
+  static constexpr uint8_t timestamp_flag = 0x80;
+
+  int64_t last_encoded{0};
+  int64_t last_decoded{0};
+
+  static int64_t ticks_of(const timestamp_t& timestamp) noexcept {
+    return static_cast<int64_t>(timestamp.time_since_epoch().count());
+  }
+
+  template <size_t I>
+  static size_t size_alternative(const V& data) {
+    using A = std::variant_alternative_t<I, V>;
+    return field_codec<A>::size(*std::get_if<I>(&data));
+  }
+
+  template <size_t I>
+  static void write_alternative(byte_writer& writer, const V& data) {
+    using A = std::variant_alternative_t<I, V>;
+    field_codec<A>::write(writer, *std::get_if<I>(&data));
+  }
+
+  template <size_t I>
+  static bool read_alternative(byte_reader& reader, V& data) {
+    using A = std::variant_alternative_t<I, V>;
+    auto* value = std::get_if<I>(&data);
+    return field_codec<A>::read(reader, value ? *value : data.template emplace<I>());
+  }
+
+  static constexpr auto sizers = []<size_t... Is>(std::index_sequence<Is...>) {
+    return std::array<size_t (*)(const V&), sizeof...(Is)>{&size_alternative<Is>...};
+  }(std::make_index_sequence<std::variant_size_v<V>>{});
+
+  static constexpr auto writers = []<size_t... Is>(std::index_sequence<Is...>) {
+    return std::array<void (*)(byte_writer&, const V&), sizeof...(Is)>{&write_alternative<Is>...};
+  }(std::make_index_sequence<std::variant_size_v<V>>{});
+
+  static constexpr auto readers = []<size_t... Is>(std::index_sequence<Is...>) {
+    return std::array<bool (*)(byte_reader&, V&), sizeof...(Is)>{&read_alternative<Is>...};
+  }(std::make_index_sequence<std::variant_size_v<V>>{});
+
+  size_t header_size(const msg_t& msg) const noexcept {
+    size_t n = 1 + varint_size(msg.serial_number);
+    if (msg.timestamp) {
+      n += varint_size(zigzag(ticks_of(*msg.timestamp) - last_encoded));
+    }
+    return n;
+  }
+
+ public:
+  /**
+   * @return 以当前编码状态编码 msg 所需的字节数
+   */
+  size_t encoded_size(const msg_t& msg) const {
+    return header_size(msg) + sizers[msg.data.index()](msg.data);
+  }
+
+  /**
+   * @brief 编码到 out 的开头
+   * @return 写入的字节数; out 空间不足时返回 nullopt, 且编码状态不变
+   */
+  std::optional<size_t> encode_to(std::span<std::byte> out, const msg_t& msg) {
+    const size_t n = encoded_size(msg);
+    if (n > out.size()) {
+      return std::nullopt;
+    }
+    byte_writer writer{out.data()};
+    const auto index = static_cast<uint8_t>(msg.data.index());
+    writer.put(&index, 1);
+    writer.varint(msg.serial_number);
+    if (msg.timestamp) {
+      *out.data() |= std::byte{timestamp_flag};
+      const int64_t ticks = ticks_of(*msg.timestamp);
+      writer.varint(zigzag(ticks - last_encoded));
+      last_encoded = ticks;
+    }
+    writers[index](writer, msg.data);
+    return n;
+  }
+
+  /**
+   * @brief 从 in 的开头解码一条消息到 msg
+   * @return 消耗的字节数; 数据截断或格式错误时返回 nullopt, 且解码状态不变 (msg 可能已被部分写入)
+   */
+  std::optional<size_t> decode_from(std::span<const std::byte> in, msg_t& msg) {
+    byte_reader reader{in.data(), in.data() + in.size()};
+    uint8_t head;
+    uint64_t serial;
+    if (!reader.get(&head, 1) || !reader.varint(serial)) {
+      return std::nullopt;
+    }
+    const size_t index = head & ~timestamp_flag;
+    if (index >= std::variant_size_v<V>) {
+      return std::nullopt;
+    }
+    int64_t ticks = last_decoded;
+    if (head & timestamp_flag) {
+      uint64_t delta;
+      if (!reader.varint(delta)) {
+        return std::nullopt;
+      }
+      ticks += unzigzag(delta);
+    }
+    if (!readers[index](reader, msg.data)) {
+      return std::nullopt;
+    }
+    msg.serial_number = serial;
+    if (head & timestamp_flag) {
+      msg.timestamp = timestamp_t{typename timestamp_t::duration{ticks}};
+      last_decoded = ticks;
+    } else {
+      msg.timestamp.reset();
+    }
+    return reader.pos - in.data();
+  }
+
+  /**
+   * @brief 清空时间戳增量的基准, 用于开始一段新的编码 / 解码序列
+   */
+  void reset() noexcept {
+    last_encoded = 0;
+    last_decoded = 0;
+  }
+};
+
+}  // namespace msg
@@ -0,0 +1,180 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <ranges>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <variant>
+#include <vector>
+
+#include "message.h"
+
+namespace msg {
+
+/**
+ * @brief 注册在第 I 个分支上的处理函数
+ */
+template <size_t I, typename F>
+struct route {
+  static constexpr size_t index = I;
+  F handler;
+};
+
+/**
+ * @brief 按消息类型分发的路由表, 处理函数在编译期按分支注册
+ * * 注册: `auto r = msg::router<V>{}.on<sum_msg>(f).on<sum_msg>(g).on<square_sum_msg>(h);`,
+ * 同一类型可以注册多个处理函数, 按注册顺序调用.
+ * * 分发: `r(msg)` 按 data.index() 查一张扁平的跳转表, 每个分支一个函数, 其中直接内联调用该分支的
+ * 所有处理函数; 没有处理函数的分支 (包括 monostate) 只计入 unhandled 计数.
+ * * 批量: `r.dispatch_grouped(batch)` 先按类型计数排序, 再逐个类型连续调用同一组处理函数,
+ * 每个类型内部保持原有顺序, 不同类型之间不保证顺序.
+ * @note 非线程安全: unhandled 计数和分组缓冲是 router 的成员
+ */
+template <valid_msg_variant V, typename... Routes>
+class router {
+  template <valid_msg_variant, typename...>
+  friend class router;
+
+  static constexpr size_t size = std::variant_size_v<V>;
+
+  std::tuple<Routes...> routes;
+  std::array<size_t, size> unhandled_counts{};
+  std::vector<uint32_t> order;  // dispatch_grouped 的排序缓冲, 跨批次复用
+
+  template <size_t I>
+  static constexpr bool handled = (false || ... || (Routes::index == I));
+
+  explicit router(std::tuple<Routes...> routes) : routes{std::move(routes)} {}
+
+  template <size_t I, typename A>
+  void call(A& value) {
+    if constexpr (handled<I>) {
+      std::apply(
+          [&](auto&... route) {
+            (
+                [&] {
+                  if constexpr (std::remove_cvref_t<decltype(route)>::index == I) {
+                    std::invoke(route.handler, value);
+                  }
+                }(),
+                ...);
+          },
+          routes);
+    } else {
+      unhandled_counts[I]++;
+    }
+  }
+
+  /**
+   * @brief 对 index 的折叠比较, 编译器将其生成为一张内联的跳转表 (没有经函数指针的间接调用)
+   */
+  template <typename D>
+  void jump(D& data) {
+    [&]<size_t... Is>(std::index_sequence<Is...>) {
+      const size_t index = data.index();
+      (void)((index == Is ? (call<Is>(*std::get_if<Is>(&data)), true) : false) || ...);
+    }(std::make_index_sequence<size>{});
+  }
+
+  template <typename E>
+  static auto& data_of(E& elem) noexcept {
+    if constexpr (std::is_const_v<E>) {
+      return static_cast<const V&>(elem);
+    } else {
+      return static_cast<V&>(elem);
+    }
+  }
+
+ public:
+  router()
+    requires(sizeof...(Routes) == 0)
+  = default;
+
+  /**
+   * @brief 为分支 T 追加一个处理函数, 返回新的 router (原 router 被移走)
+   */
+  template <type_in_variant<V> T, typename F>
+    requires std::invocable<F&, T&> || std::invocable<F&, const T&>
+  auto on(F handler) && {
+    using next_t = router<V, Routes..., route<type_in_variant_<T, V>::index, F>>;
+    return next_t{std::tuple_cat(std::move(routes),
+                                 std::tuple{route<type_in_variant_<T, V>::index, F>{
+                                     std::move(handler)}})};
+  }
+
+  void operator()(V& data) {
+    jump(data);
+  }
+
+  void operator()(const V& data) {
+    jump(data);
+  }
+
+  void operator()(message<V>& msg) {
+    (*this)(msg.data);
+  }
+
+  void operator()(const message<V>& msg) {
+    (*this)(msg.data);
+  }
+
+  /**
+   * @brief 按类型分组后分发一批消息 (元素为 message<V> 或 V)
+   * @return 分发的消息数
+   */
+  template <std::ranges::random_access_range R>
+    requires std::ranges::sized_range<R> &&
+             std::convertible_to<std::ranges::range_reference_t<R>, const V&>
+  size_t dispatch_grouped(R&& batch) {
+    const size_t n = std::ranges::size(batch);
+    auto first = std::ranges::begin(batch);
+    std::array<size_t, size + 1> offsets{};
+    for (size_t i = 0; i < n; i++) {
+      offsets[data_of(first[i]).index() + 1]++;
+    }
+    for (size_t i = 0; i < size; i++) {
+      offsets[i + 1] += offsets[i];
+    }
+    order.resize(n);
+    auto cursor = offsets;
+    for (size_t i = 0; i < n; i++) {
+      order[cursor[data_of(first[i]).index()]++] = (uint32_t)i;
+    }
+    [&]<size_t... Is>(std::index_sequence<Is...>) {
+      (
+          [&] {
+            if constexpr (handled<Is>) {
+              for (size_t k = offsets[Is]; k < offsets[Is + 1]; k++) {
+                call<Is>(*std::get_if<Is>(&data_of(first[order[k]])));
+              }
+            } else {
+              unhandled_counts[Is] += offsets[Is + 1] - offsets[Is];
+            }
+          }(),
+          ...);
+    }(std::make_index_sequence<size>{});
+    return n;
+  }
+
+  /**
+   * @return 没有处理函数而被忽略的消息数
+   */
+  size_t unhandled() const noexcept {
+    size_t total = 0;
+    for (size_t count : unhandled_counts) {
+      total += count;
+    }
+    return total;
+  }
+
+  template <type_in_variant<V> T>
+  size_t unhandled() const noexcept {
+    return unhandled_counts[type_in_variant_<T, V>::index];
+  }
+};
+
+}  // namespace msg
@@ -0,0 +1,506 @@
+#pragma once
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <concepts>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <format>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <type_traits>
+#include <utility>
+#include <variant>
+#include <vector>
+
+#include "concurrency_utils.h"
+#include "message.h"
+
+namespace playground {
+
+struct persistent_stream_options {
+  std::filesystem::path dir;
+  size_t segment_bytes{(size_t)64 << 20};
+  size_t sync_every{1024};  // 每写入 sync_every 条记录 fdatasync 一次, 0 表示只在 sync() / 析构时同步
+};
+
+template <typename V>
+struct persistable_variant_ : public std::false_type {};
+
+template <typename... Ts>
+struct persistable_variant_<std::variant<Ts...>>
+    : public std::bool_constant<(true && ... &&
+                                 (std::is_trivially_copyable_v<Ts> &&
+                                  std::is_default_constructible_v<Ts>))> {};
+
+/**
+ * @brief 可按字节落盘的消息: 所有分支都是 trivially copyable 的
+ */
+template <typename V>
+concept persistable_variant = msg::valid_msg_variant<V> && persistable_variant_<V>::value;
+
+/**
+ * @brief 持久化的 sync_stream: 消息追加写入分段的内存映射文件 (append-only log)
+ * * 文件: dir 下的 `{base_serial:020}.log`, 每个大小为 segment_bytes, 写满后滚动到新分段;
+ * 记录为 [record_header | payload], 8 字节对齐, 序列号由 log 分配且连续.
+ * * 索引: 每个分段记录各条消息的偏移, 按 serial_number 定位为 O(log segments).
+ * * 持久性: 每 sync_every 条记录在锁外 fdatasync 一次 (组提交), 滚动分段时同步旧分段;
+ * 崩溃时最后一次同步之后的记录可能丢失, 重新打开时按校验和截断到最后一条完整记录.
+ * * 读取: `read_sync` 是单个消费游标 (语义同 sync_stream), 从 log 起点开始, 可 `seek`;
+ * `replay(from, callback)` 直接在映射内存上遍历记录 (record_view), 不复制也不阻塞写入.
+ * @note 分段在 stream 生命周期内保持映射, 不做保留期清理
+ */
+template <typename T, std::invocable TSGen = default_timestamp_generator>
+  requires persistable_variant<typename T::variant_t> && requires(T t) {
+    t.timestamp = std::declval<TSGen>()();
+  } && std::is_default_constructible_v<TSGen>
+class persistent_stream {
+ public:
+  using msg_t = T;
+  using variant_t = typename T::variant_t;
+  using timestamp_t = typename T::timestamp_t;
+  using status = sync_stream_read_write_status;  // template params independent
+
+ private:
+  static constexpr std::array<char, 8> magic{'P', 'G', 'L', 'O', 'G', '0', '0', '1'};
+  static constexpr int64_t no_timestamp = INT64_MIN;
+
+  struct segment_header {
+    std::array<char, 8> magic;
+    uint64_t base_serial;
+  };
+
+  struct record_header {
+    uint64_t serial;
+    int64_t timestamp;
+    uint32_t index;
+    uint32_t size;
+    uint32_t checksum;
+    uint32_t reserved;
+  };
+
+  static constexpr size_t align8(size_t n) noexcept {
+    return (n + 7) & ~(size_t)7;
+  }
+
+  static uint32_t checksum_of(const record_header& header, const std::byte* payload) noexcept {
+    uint32_t hash = 2166136261u;  // FNV-1a
+    auto feed = [&](const void* p, size_t n) {
+      auto bytes = static_cast<const unsigned char*>(p);
+      for (size_t i = 0; i < n; i++) {
+        hash = (hash ^ bytes[i]) * 16777619u;
+      }
+    };
+    feed(&header, offsetof(record_header, checksum));
+    feed(payload, header.size);
+    return hash;
+  }
+
+  [[noreturn]] static void throw_errno(const std::string& what) {
+    throw std::system_error{errno, std::generic_category(), what};
+  }
+
+  struct segment {
+    int fd{-1};
+    std::byte* base{nullptr};
+    size_t capacity{};
+    uint64_t base_serial{};
+    std::vector<uint32_t> offsets;  // offsets[serial - base_serial]
+    std::atomic<size_t> tail{sizeof(segment_header)};
+
+    segment(const std::filesystem::path& path, size_t capacity, uint64_t base_serial, bool create)
+        : capacity{capacity}, base_serial{base_serial} {
+      fd = ::open(path.c_str(), create ? O_RDWR | O_CREAT | O_EXCL : O_RDWR, 0644);
+      if (fd < 0) {
+        throw_errno(std::format("open {}", path.string()));
+      }
+      if (create && ::ftruncate(fd, (off_t)capacity) != 0) {
+        ::close(fd);
+        throw_errno(std::format("ftruncate {}", path.string()));
+      }
+      void* p = ::mmap(nullptr, capacity, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+      if (p == MAP_FAILED) {
+        ::close(fd);
+        throw_errno(std::format("mmap {}", path.string()));
+      }
+      base = static_cast<std::byte*>(p);
+      if (create) {
+        segment_header header{.magic = magic, .base_serial = base_serial};
+        std::memcpy(base, &header, sizeof(header));
+      }
+    }
+
+    segment(const segment&) = delete;
+    segment& operator=(const segment&) = delete;
+
+    ~segment() {
+      ::munmap(base, capacity);
+      ::close(fd);
+    }
+
+    void sync() const noexcept {
+      ::fdatasync(fd);
+    }
+
+    const record_header& header_at(size_t offset) const noexcept {
+      return *reinterpret_cast<const record_header*>(base + offset);
+    }
+  };
+
+ public:
+  /**
+   * @brief 映射内存中的一条记录, 仅在 replay 回调期间有效
+   */
+  struct record_view {
+    uint64_t serial_number;
+    std::optional<timestamp_t> timestamp;
+    size_t index;
+    std::span<const std::byte> payload;
+
+    template <msg::type_in_variant<variant_t> A>
+    bool holds() const noexcept {
+      return index == msg::type_in_variant_<A, variant_t>::index;
+    }
+
+    template <msg::type_in_variant<variant_t> A>
+    A get() const noexcept {
+      A value;
+      std::memcpy(&value, payload.data(), sizeof(A));
+      return value;
+    }
+
+    msg_t decode() const {
+      msg_t msg;
+      decoders[index](msg.data, payload.data());
+      msg.serial_number = serial_number;
+      msg.timestamp = timestamp;
+      return msg;
+    }
+  };
+
+ private:
+  template <size_t I>
+  static void decode_alternative(variant_t& data, const std::byte* payload) {
+    auto& value = data.template emplace<I>();
+    std::memcpy(&value, payload, sizeof(value));
+  }
+
+  static constexpr auto decoders = []<size_t... Is>(std::index_sequence<Is...>) {
+    return std::array<void (*)(variant_t&, const std::byte*), sizeof...(Is)>{
+        &decode_alternative<Is>...};
+  }(std::make_index_sequence<std::variant_size_v<variant_t>>{});
+
+  persistent_stream_options options;
+  TSGen ts_gen{};
+  mutable std::mutex mutex;
+  stoppable_cv cv;
+  std::vector<std::unique_ptr<segment>> segments;
+  uint64_t next_serial{1};
+  uint64_t read_serial{1};
+  size_t unsynced{0};
+
+  std::filesystem::path path_of(uint64_t base_serial) const {
+    return options.dir / std::format("{:020}.log", base_serial);
+  }
+
+  /**
+   * @brief 扫描已有分段重建索引, 截断到最后一条完整记录
+   * * 第一个无法接续的分段及其后的所有分段改名为 `*.log.corrupt` 保留, 不再参与恢复;
+   * 否则之后按 next_serial 新建的分段可能与这些文件重名 (O_EXCL 失败).
+   * 分段名会被重新使用, 同名的 `.corrupt` 已存在时追加序号 (`.corrupt.1`, ...), 不覆盖之前保留的文件.
+   */
+  void recover() {
+    std::vector<std::filesystem::path> files;
+    for (const auto& entry : std::filesystem::directory_iterator{options.dir}) {
+      if (entry.is_regular_file() && entry.path().extension() == ".log") {
+        files.push_back(entry.path());
+      }
+    }
+    std::ranges::sort(files);
+    size_t recovered = 0;
+    for (; recovered < files.size(); recovered++) {
+      const auto& file = files[recovered];
+      const size_t capacity = std::filesystem::file_size(file);
+      if (capacity < sizeof(segment_header)) {
+        break;
+      }
+      segment_header header{};
+      auto seg = std::make_unique<segment>(file, capacity, 0, false);
+      std::memcpy(&header, seg->base, sizeof(header));
+      if (header.magic != magic || (!segments.empty() && header.base_serial != next_serial)) {
+        break;
+      }
+      seg->base_serial = header.base_serial;
+      next_serial = header.base_serial;
+      size_t offset = sizeof(segment_header);
+      while (offset + sizeof(record_header) <= capacity) {
+        const auto& record = seg->header_at(offset);
+        const size_t next = offset + align8(sizeof(record_header) + record.size);
+        if (record.serial != next_serial || next > capacity ||
+            record.checksum != checksum_of(record, seg->base + offset + sizeof(record_header))) {
+          break;
+        }
+        seg->offsets.push_back((uint32_t)offset);
+        next_serial++;
+        offset = next;
+      }
+      if (offset + sizeof(record_header) <= capacity && seg->header_at(offset).serial != 0) {
+        // 崩溃留下的残缺记录: 清零, 避免之后的恢复把旧字节当作新记录
+        std::memset(seg->base + offset, 0, capacity - offset);
+      }
+      seg->tail.store(offset, std::memory_order_relaxed);
+      segments.push_back(std::move(seg));
+    }
+    for (size_t i = recovered; i < files.size(); i++) {
+      auto corrupt = files[i];
+      corrupt += ".corrupt";
+      for (size_t n = 1; std::filesystem::exists(corrupt); n++) {
+        corrupt = files[i];
+        corrupt += std::format(".corrupt.{}", n);
+      }
+      std::filesystem::rename(files[i], corrupt);
+    }
+    if (!segments.empty()) {
+      read_serial = segments.front()->base_serial;
+    }
+  }
+
+  segment& writable_segment(size_t bytes) {
+    if (bytes + sizeof(segment_header) > options.segment_bytes) {
+      throw std::length_error{"persistent_stream: record larger than segment_bytes"};
+    }
+    if (segments.empty() ||
+        segments.back()->tail.load(std::memory_order_relaxed) + bytes >
+            segments.back()->capacity) {
+      if (!segments.empty()) {
+        segments.back()->sync();
+      }
+      segments.push_back(std::make_unique<segment>(path_of(next_serial), options.segment_bytes,
+                                                   next_serial, true));
+      unsynced = 0;
+    }
+    return *segments.back();
+  }
+
+  /**
+   * @pre 持有 mutex, first_serial() <= serial < next_serial
+   */
+  std::pair<segment*, size_t> locate(uint64_t serial) const {
+    auto it = std::ranges::upper_bound(segments, serial, std::less<>{},
+                                       [](const auto& seg) { return seg->base_serial; });
+    segment* seg = std::prev(it)->get();
+    return {seg, seg->offsets[serial - seg->base_serial]};
+  }
+
+  static record_view view_of(const segment& seg, size_t offset) {
+    const auto& record = seg.header_at(offset);
+    std::optional<timestamp_t> timestamp;
+    if (record.timestamp != no_timestamp) {
+      timestamp = timestamp_t{std::chrono::duration_cast<typename timestamp_t::duration>(
+          std::chrono::nanoseconds{record.timestamp})};
+    }
+    return {.serial_number = record.serial,
+            .timestamp = timestamp,
+            .index = record.index,
+            .payload = {seg.base + offset + sizeof(record_header), record.size}};
+  }
+
+  static int64_t encode_timestamp(const std::optional<timestamp_t>& timestamp) noexcept {
+    if (!timestamp) {
+      return no_timestamp;
+    }
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(timestamp->time_since_epoch())
+        .count();
+  }
+
+ public:
+  explicit persistent_stream(persistent_stream_options options) : options{std::move(options)} {
+    if (this->options.segment_bytes > UINT32_MAX) {
+      throw std::invalid_argument{"persistent_stream: segment_bytes must fit in 32 bits"};
+    }
+    std::filesystem::create_directories(this->options.dir);
+    recover();
+  }
+
+  persistent_stream(const persistent_stream&) = delete;
+  persistent_stream& operator=(const persistent_stream&) = delete;
+
+  ~persistent_stream() {
+    sync();
+  }
+
+  template <typename U>
+    requires requires(U&& data) { msg_t{std::forward<U>(data)}; }
+  status write_sync(U&& data) {
+    msg_t msg{std::forward<U>(data)};
+    if constexpr (thread_safe_timestamp_generator<TSGen>) {
+      msg.timestamp = ts_gen();
+    }
+    segment* to_sync = nullptr;
+    {
+      std::lock_guard lock{mutex};
+      if constexpr (!thread_safe_timestamp_generator<TSGen>) {
+        msg.timestamp = ts_gen();
+      }
+      record_header header{.serial = next_serial,
+                           .timestamp = encode_timestamp(msg.timestamp),
+                           .index = (uint32_t)msg.data.index()};
+      std::visit([&](const auto& value) { header.size = sizeof(value); }, msg.data);
+      auto& seg = writable_segment(align8(sizeof(record_header) + header.size));
+      const size_t offset = seg.tail.load(std::memory_order_relaxed);
+      std::byte* payload = seg.base + offset + sizeof(record_header);
+      std::visit([&](const auto& value) { std::memcpy(payload, &value, sizeof(value)); },
+                 msg.data);
+      header.checksum = checksum_of(header, payload);
+      std::memcpy(seg.base + offset, &header, sizeof(header));
+      seg.offsets.push_back((uint32_t)offset);
+      seg.tail.store(offset + align8(sizeof(record_header) + header.size),
+                     std::memory_order_release);
+      next_serial++;
+      if (options.sync_every != 0 && ++unsynced >= options.sync_every) {
+        unsynced = 0;
+        to_sync = &seg;
+      }
+    }
+    cv->notify_one();
+    if (to_sync != nullptr) {
+      to_sync->sync();  // 组提交: 不阻塞其他写入方
+    }
+    return status::good;
+  }
+
+  status read_sync(T& data) {
+    std::unique_lock lock{mutex};
+    cv->wait(lock, [this]() { return read_serial < next_serial || cv.is_stopped(); });
+    if (read_serial == next_serial) {
+      return status::empty;
+    }
+    auto [seg, offset] = locate(read_serial++);
+    lock.unlock();
+    data = view_of(*seg, offset).decode();  // 记录写入后不再修改, 可在锁外解码
+    return status::good;
+  }
+
+  /**
+   * @brief 在映射内存上遍历 [from, end_serial()) 的记录, callback(const record_view&)
+   * @return 遍历的记录数
+   */
+  template <std::invocable<const record_view&> F>
+  size_t replay(uint64_t from, F&& callback) const {
+    std::vector<segment*> snapshot;
+    uint64_t end{};
+    size_t offset{};
+    {
+      std::lock_guard lock{mutex};
+      end = next_serial;
+      if (segments.empty() || from >= end) {
+        return 0;
+      }
+      from = std::max<uint64_t>(from, segments.front()->base_serial);
+      offset = locate(from).second;
+      for (const auto& seg : segments) {
+        if (seg->base_serial + seg->offsets.size() > from) {
+          snapshot.push_back(seg.get());
+        }
+      }
+    }
+    size_t count = 0;
+    uint64_t serial = from;
+    for (segment* seg : snapshot) {
+      while (serial < end) {
+        if (offset + sizeof(record_header) > seg->capacity ||
+            seg->header_at(offset).serial != serial) {
+          break;  // 分段结束
+        }
+        const auto view = view_of(*seg, offset);
+        std::invoke(callback, view);
+        offset += align8(sizeof(record_header) + view.payload.size());
+        serial++;
+        count++;
+      }
+      offset = sizeof(segment_header);
+    }
+    return count;
+  }
+
+  /**
+   * @brief 移动 read_sync 的游标
+   */
+  void seek(uint64_t serial) {
+    std::lock_guard lock{mutex};
+    read_serial = std::clamp<uint64_t>(serial, first_serial_(), next_serial);
+  }
+
+  template <typename U>
+    requires requires(U&& data) { msg_t{std::forward<U>(data)}; }
+  status operator<<(U&& data) {
+    return write_sync(std::forward<U>(data));
+  }
+
+  status operator>>(T& data) {
+    return read_sync(data);
+  }
+
+  operator bool() const {
+    std::lock_guard lock{mutex};
+    return read_serial < next_serial || !cv.is_stopped();
+  }
+
+  void stop() {
+    {
+      std::lock_guard lock{mutex};
+      cv.stop();
+    }
+  }
+
+  void sync() {
+    std::lock_guard lock{mutex};
+    if (!segments.empty()) {
+      segments.back()->sync();
+    }
+    unsynced = 0;
+  }
+
+  uint64_t first_serial() {
+    std::lock_guard lock{mutex};
+    return first_serial_();
+  }
+
+  uint64_t end_serial() {
+    std::lock_guard lock{mutex};
+    return next_serial;
+  }
+
+  size_t segment_count() {
+    std::lock_guard lock{mutex};
+    return segments.size();
+  }
+
+  template <typename Op, typename Executor>
+  auto get_dispatcher(Op op, Executor&& executor) {
+    return async::make_dispatcher<msg_t, Op>(*this, std::forward<Executor>(executor));
+  }
+
+ private:
+  uint64_t first_serial_() const noexcept {
+    return segments.empty() ? next_serial : segments.front()->base_serial;
+  }
+};
+
+}  // namespace playground
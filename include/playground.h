@@ -30,6 +30,7 @@
 
 #include "toyqueue.h"
 #include "async_tool.h"
+#include "matrix.h"
 
 namespace playground {
 
@@ -88,99 +89,21 @@ auto timer_wrap(F f) {
   };
 }
 
-template <typename T>
-struct Matrix2D {
-  Matrix2D(size_t row, size_t col) : row{row}, col{col} {
-    alloc();
-  }
-
-  Matrix2D(Matrix2D&& other) noexcept = default;
-  Matrix2D& operator=(Matrix2D&& other) noexcept = default;
-
-  Matrix2D(const Matrix2D& other) : Matrix2D{other.row, other.col} {
-    copy_from(other);
-  }
-
-  template <typename U>
-  Matrix2D(const Matrix2D<U>& other) : Matrix2D{other.row, other.col} {
-    copy_from(other);
-  }
-
-  Matrix2D& operator=(const Matrix2D& other) {
-    if (this == &other) {
-      return *this;
-    }
-    *this = Matrix2D{other};
-    return *this;
-  }
+void play_with_matrix();
 
-  template <typename U>
-  Matrix2D& operator=(const Matrix2D<U>& other) {
-    if (this == &other) {
-      return *this;
-    }
-    *this = Matrix2D{other};
-    return *this;
-  }
+void try_matrix_layout();
 
-  T& operator[](size_t r, size_t c) {
-    if (data) {
-      if (r < row && c < col) {
-        return data[r][c];
-      }
-      throw std::runtime_error("index (r, c) is out of range.");
-    }
-    throw std::runtime_error("data of Matrix2D is nullptr.");
-  }
+void try_matrix_multiply();
 
-  const T& operator[](size_t r, size_t c) const {
-    if (data) {
-      if (r < row && c < col) {
-        return data[r][c];
-      }
-      throw std::runtime_error("index (r, c) is out of range.");
-    }
-    throw std::runtime_error("data of Matrix2D is nullptr.");
-  }
+void try_matrix_parallel();
 
-  friend std::ostream& operator<<(std::ostream& os, const Matrix2D& obj) {
-    if (obj.data) {
-      for (size_t r = 0; r < obj.row; r++) {
-        for (size_t c = 0; c < obj.col; c++) {
-          os << obj[r, c] << ' ';
-        }
-        os << std::endl;
-      }
-    }
-    return os;
-  }
+void try_matrix_expr();
 
- private:
-  std::unique_ptr<std::unique_ptr<T[]>[]> data{};
-  size_t row{};
-  size_t col{};
-
-  template <typename U>
-  friend class Matrix2D;
-
-  void alloc() {
-    std::unique_ptr<std::unique_ptr<T[]>[]> _data{new std::unique_ptr<T[]>[row] {}};
-    for (size_t r = 0; r < row; r++) {
-      _data[r] = std::unique_ptr<T[]>{new T[col]{}};
-    }
-    data = std::move(_data);
-  }
+void try_matrix_transpose();
 
-  template <typename U>
-    requires std::convertible_to<U, T> && std::copy_constructible<T>
-  void copy_from(const Matrix2D<U>& other) {
-    for (size_t r = 0; r < row; r++) {
-      std::copy(other.data[r].get(), other.data[r].get() + col, data[r].get());
-    }
-  }
-};
+void try_matrix_file();
 
-void play_with_matrix();
+void try_sparse_matrix();
 
 void try_shared_mutex();
 
@@ -202,6 +125,30 @@ void try_message();
 
 void try_msg_stream();
 
+void try_msg_stream2();
+
+void try_msg_stream3();
+
+void try_msg_stream4();
+
+void try_msg_stream5();
+
+void try_msg_stream6();
+
+void try_msg_stream7();
+
+void try_msg_stream8();
+
+void try_msg_stream9();
+
+void try_msg_codec();
+
+void try_msg_arena();
+
+void try_msg_router();
+
+void try_msg_batch();
+
 void try_coroutine();
 
 void try_toy_queue();
@@ -275,4 +222,14 @@ void try_await15();
 
 void try_await16();
 
+void try_await17();
+
+void try_await18();
+
+void try_await19();
+
+void try_await20();
+
+void try_await21();
+
 }  // namespace playground
@@ -0,0 +1,427 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <concepts>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <ranges>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <variant>
+#include <vector>
+
+#include "concurrency_utils.h"
+#include "message.h"
+
+namespace playground {
+
+/**
+ * @brief 不可变的消息信封, 引用计数侵入在信封内
+ * * 发布时引用计数一次性置为投递的订阅者数, 之后每个订阅者释放一次, 没有逐个 +1 的原子操作
+ */
+template <typename T>
+struct envelope {
+  std::atomic<uint32_t> refs;
+  const T msg;
+
+  template <typename... Args>
+  explicit envelope(uint32_t refs, Args&&... args)
+      : refs{refs}, msg{std::forward<Args>(args)...} {}
+
+  void release() noexcept {
+    if (refs.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+      delete this;
+    }
+  }
+};
+
+/**
+ * @brief envelope 的侵入式智能指针, 只提供 const 访问
+ */
+template <typename T>
+class envelope_ptr {
+  envelope<T>* ptr{nullptr};
+
+ public:
+  envelope_ptr() noexcept = default;
+
+  /**
+   * @brief 接管 p 上的一个引用 (不增加计数)
+   */
+  explicit envelope_ptr(envelope<T>* p) noexcept : ptr{p} {}
+
+  envelope_ptr(const envelope_ptr& other) noexcept : ptr{other.ptr} {
+    if (ptr != nullptr) {
+      ptr->refs.fetch_add(1, std::memory_order_relaxed);
+    }
+  }
+
+  envelope_ptr(envelope_ptr&& other) noexcept : ptr{std::exchange(other.ptr, nullptr)} {}
+
+  envelope_ptr& operator=(envelope_ptr other) noexcept {
+    std::swap(ptr, other.ptr);
+    return *this;
+  }
+
+  ~envelope_ptr() {
+    if (ptr != nullptr) {
+      ptr->release();
+    }
+  }
+
+  const T& operator*() const noexcept {
+    return ptr->msg;
+  }
+
+  const T* operator->() const noexcept {
+    return &ptr->msg;
+  }
+
+  const T* get() const noexcept {
+    return ptr == nullptr ? nullptr : &ptr->msg;
+  }
+
+  explicit operator bool() const noexcept {
+    return ptr != nullptr;
+  }
+};
+
+enum class overflow_policy : std::uint8_t {
+  block,  // 订阅者落后 capacity 条时, 发布方等待
+  drop,   // 订阅者落后 capacity 条时, 丢弃投递给它的新消息并计数
+};
+
+/**
+ * @brief 消息的发布 / 订阅中心: 一条消息只分配一个信封, 每个订阅者只写入一个指针
+ * * 订阅: `auto sub = hub.subscribe<sum_msg, square_sum_msg>(capacity, policy);`,
+ * 模板参数为空时订阅所有类型. 每个订阅者有一个容量为 capacity 的单生产者单消费者环形队列,
+ * capacity 即该订阅者允许的最大滞后; 超出时按 overflow_policy 阻塞发布方或丢弃.
+ * * 发布: `publish(data)` / `publish_many(range)` 在一把锁内分配序列号并按顺序投递,
+ * 因此每个订阅者看到的消息顺序一致; publish_many 对每个订阅者只唤醒一次.
+ * * 读取: `sub.read_sync(envelope_ptr&)` / `sub.read_many(output, max)`, 阻塞语义同 sync_stream.
+ * * 停止: `stop()` 不获取发布锁, 即使发布方正阻塞在不再读取的订阅者上也能关闭所有订阅并唤醒它.
+ * @warning hub 的生命周期须覆盖所有 subscription;
+ *          overflow_policy::block 下, 不再读取的订阅者会使发布方一直等待 (其间 subscribe 也需等待),
+ *          直到该 subscription 析构或 stop.
+ */
+template <typename T, std::invocable IDGen = default_id_generator,
+          std::invocable TSGen = default_timestamp_generator>
+  requires msg::some_variant<typename T::variant_t> &&
+           (std::variant_size_v<typename T::variant_t> <= 64) && requires(T t) {
+             t.serial_number = std::declval<IDGen>()();
+             t.timestamp = std::declval<TSGen>()();
+           } && std::is_default_constructible_v<IDGen> && std::is_default_constructible_v<TSGen>
+class pubsub_hub {
+ public:
+  using msg_t = T;
+  using variant_t = typename T::variant_t;
+  using ptr_t = envelope_ptr<T>;
+  using status = sync_stream_read_write_status;  // template params independent
+
+ private:
+  struct subscriber {
+    const uint64_t mask;
+    const overflow_policy policy;
+    const size_t capacity;
+    std::vector<envelope<T>*> ring;
+    alignas(64) std::atomic<size_t> head{0};  // 消费方写
+    alignas(64) std::atomic<size_t> tail{0};  // 发布方写
+    std::atomic<size_t> dropped{0};
+    std::atomic<bool> closed{false};
+    eventcount readable;
+    eventcount writable;
+
+    subscriber(uint64_t mask, overflow_policy policy, size_t capacity)
+        : mask{mask}, policy{policy}, capacity{capacity}, ring(capacity) {}
+
+    ~subscriber() {
+      for (size_t i = head.load(); i != tail.load(); i++) {
+        ring[i % capacity]->release();
+      }
+    }
+
+    bool wants(size_t index) const noexcept {
+      return ((mask >> index) & 1) != 0;
+    }
+
+    /**
+     * @brief 等待到有空位, 仅发布方调用; false 表示应当丢弃
+     */
+    bool reserve(size_t count) {
+      const size_t t = tail.load(std::memory_order_relaxed);
+      while (t + count - head.load(std::memory_order_acquire) > capacity) {
+        if (policy == overflow_policy::drop || closed.load(std::memory_order_acquire)) {
+          return false;
+        }
+        readable.notify_one();  // publish_many 推迟了唤醒, 等待前先确保消费方在读取
+        auto key = writable.prepare_wait();
+        if (t + count - head.load(std::memory_order_acquire) <= capacity ||
+            closed.load(std::memory_order_acquire)) {
+          writable.cancel_wait();
+          continue;
+        }
+        writable.wait(key);
+      }
+      return true;
+    }
+
+    void push(envelope<T>* e) noexcept {
+      const size_t t = tail.load(std::memory_order_relaxed);
+      ring[t % capacity] = e;
+      tail.store(t + 1, std::memory_order_release);
+    }
+
+    template <typename Out>
+    size_t pop_many(Out& output, size_t max) {
+      const size_t h = head.load(std::memory_order_relaxed);
+      const size_t n = std::min(max, tail.load(std::memory_order_acquire) - h);
+      for (size_t i = 0; i < n; i++) {
+        *output++ = ptr_t{ring[(h + i) % capacity]};
+      }
+      if (n != 0) {
+        head.store(h + n, std::memory_order_release);
+        writable.notify_one();
+      }
+      return n;
+    }
+
+    template <typename Out>
+    size_t read_many(Out& output, size_t max) {
+      if (max == 0) {
+        return 0;
+      }
+      while (true) {
+        if (size_t n = pop_many(output, max); n != 0) {
+          return n;
+        }
+        if (closed.load(std::memory_order_acquire)) {
+          return pop_many(output, max);
+        }
+        auto key = readable.prepare_wait();
+        if (tail.load(std::memory_order_acquire) != head.load(std::memory_order_relaxed) ||
+            closed.load(std::memory_order_acquire)) {
+          readable.cancel_wait();
+          continue;
+        }
+        readable.wait(key);
+      }
+    }
+
+    void close() noexcept {
+      closed.store(true, std::memory_order_release);
+      readable.notify_all();
+      writable.notify_all();
+    }
+  };
+
+  IDGen id_gen{};
+  TSGen ts_gen{};
+  std::mutex mutex;  // 发布顺序与 subscribers; 发布方可能持有它阻塞在 reserve 中
+  std::vector<std::shared_ptr<subscriber>> subscribers;
+  std::mutex registry_mutex;  // 只保护 registry, 持有者从不阻塞; 加锁顺序为 mutex -> registry_mutex
+  std::vector<std::shared_ptr<subscriber>> registry;  // subscribers 的副本, 供 stop 在发布锁外遍历
+  std::atomic<bool> stopped{false};
+
+  template <typename U>
+  static constexpr size_t static_index =
+      msg::type_in_variant_<std::remove_cvref_t<U>, variant_t>::index;
+
+  void unsubscribe(const std::shared_ptr<subscriber>& sub) {
+    sub->close();
+    std::lock_guard lock{mutex};
+    std::erase(subscribers, sub);
+    std::lock_guard registry_lock{registry_mutex};
+    std::erase(registry, sub);
+  }
+
+  /**
+   * @pre 持有 mutex; targets 为本条消息需要投递的订阅者
+   * @note targets 持有 shared_ptr: 唤醒在锁外进行, 期间 unsubscribe 可能已把订阅者移出 subscribers
+   */
+  void deliver(msg_t&& msg, std::vector<std::shared_ptr<subscriber>>& targets) {
+    const size_t index = static_cast<const variant_t&>(msg).index();
+    targets.clear();
+    for (auto& sub : subscribers) {
+      if (!sub->wants(index)) {
+        continue;
+      }
+      if (sub->reserve(1)) {
+        targets.push_back(sub);
+      } else {
+        sub->dropped.fetch_add(1, std::memory_order_relaxed);
+      }
+    }
+    if (targets.empty()) {
+      return;
+    }
+    auto* e = new envelope<T>{(uint32_t)targets.size(), std::move(msg)};
+    for (auto& sub : targets) {
+      sub->push(e);
+    }
+  }
+
+  msg_t stamp(msg_t msg) {
+    msg.serial_number = id_gen();
+    msg.timestamp = ts_gen();
+    return msg;
+  }
+
+ public:
+  class subscription {
+    pubsub_hub* hub{nullptr};
+    std::shared_ptr<subscriber> sub;
+
+   public:
+    subscription(pubsub_hub& hub, std::shared_ptr<subscriber> sub)
+        : hub{&hub}, sub{std::move(sub)} {}
+    subscription(subscription&&) noexcept = default;
+
+    subscription& operator=(subscription other) noexcept {
+      std::swap(hub, other.hub);
+      std::swap(sub, other.sub);
+      return *this;
+    }
+
+    ~subscription() {
+      if (sub) {
+        hub->unsubscribe(sub);
+      }
+    }
+
+    status read_sync(ptr_t& data) {
+      ptr_t* output = &data;
+      return sub->read_many(output, 1) != 0 ? status::good : status::empty;
+    }
+
+    status operator>>(ptr_t& data) {
+      return read_sync(data);
+    }
+
+    /**
+     * @brief 批量读取: 阻塞到有消息或 stop, 之后一次取出至多 max 个信封
+     * @return 读出的信封数, 0 表示 hub 已停止且队列为空; max 为 0 时不阻塞, 直接返回 0
+     */
+    template <std::output_iterator<ptr_t&&> Out>
+    size_t read_many(Out output, size_t max) {
+      return sub->read_many(output, max);
+    }
+
+    operator bool() const noexcept {
+      return sub->tail.load(std::memory_order_acquire) !=
+                 sub->head.load(std::memory_order_relaxed) ||
+             !sub->closed.load(std::memory_order_acquire);
+    }
+
+    /**
+     * @return 尚未读取的消息数
+     */
+    size_t lag() const noexcept {
+      return sub->tail.load(std::memory_order_acquire) - sub->head.load(std::memory_order_acquire);
+    }
+
+    size_t dropped() const noexcept {
+      return sub->dropped.load(std::memory_order_relaxed);
+    }
+  };
+
+  /**
+   * @param capacity 最大滞后的消息数
+   * @note Ts 为空时订阅所有类型
+   */
+  template <msg::type_in_variant<variant_t>... Ts>
+  subscription subscribe(size_t capacity = 1024, overflow_policy policy = overflow_policy::block) {
+    uint64_t mask = 0;
+    if constexpr (sizeof...(Ts) == 0) {
+      mask = ~(uint64_t)0;
+    } else {
+      mask = (... | ((uint64_t)1 << static_index<Ts>));
+    }
+    auto sub = std::make_shared<subscriber>(mask, policy, std::max<size_t>(1, capacity));
+    std::lock_guard lock{mutex};
+    subscribers.push_back(sub);
+    std::lock_guard registry_lock{registry_mutex};
+    registry.push_back(sub);
+    if (stopped.load(std::memory_order_acquire)) {  // stop 先于本次加锁完成, 没有看到 sub
+      sub->close();
+    }
+    return {*this, std::move(sub)};
+  }
+
+  /**
+   * @return 投递的订阅者数
+   */
+  template <typename U>
+    requires requires(U&& data) { msg_t{std::forward<U>(data)}; }
+  size_t publish(U&& data) {
+    msg_t msg{std::forward<U>(data)};
+    std::vector<std::shared_ptr<subscriber>> targets;
+    {
+      std::lock_guard lock{mutex};
+      deliver(stamp(std::move(msg)), targets);
+    }
+    for (auto& sub : targets) {
+      sub->readable.notify_one();
+    }
+    return targets.size();
+  }
+
+  /**
+   * @brief 批量发布: 一次加锁, 连续的序列号, 每个订阅者只唤醒一次
+   * @return 投递次数之和
+   */
+  template <std::ranges::input_range R>
+    requires requires(std::ranges::range_reference_t<R> data) {
+      msg_t{std::forward<decltype(data)>(data)};
+    }
+  size_t publish_many(R&& range) {
+    std::vector<std::shared_ptr<subscriber>> targets;
+    std::vector<std::shared_ptr<subscriber>> woken;
+    size_t count = 0;
+    {
+      std::lock_guard lock{mutex};
+      for (auto&& data : range) {
+        deliver(stamp(msg_t{std::forward<decltype(data)>(data)}), targets);
+        count += targets.size();
+        for (auto& sub : targets) {
+          if (std::ranges::find(woken, sub) == woken.end()) {
+            woken.push_back(std::move(sub));
+          }
+        }
+      }
+    }
+    for (auto& sub : woken) {
+      sub->readable.notify_one();
+    }
+    return count;
+  }
+
+  template <typename U>
+    requires requires(U&& data) { msg_t{std::forward<U>(data)}; }
+  size_t operator<<(U&& data) {
+    return publish(std::forward<U>(data));
+  }
+
+  /**
+   * @brief 关闭所有订阅: 已投递的消息仍可读出, 之后 read_sync 返回 empty
+   * * 不获取发布锁: 阻塞在 reserve 中的发布方被 close 唤醒, 把剩余的投递计为丢弃后返回
+   */
+  void stop() {
+    stopped.store(true, std::memory_order_release);
+    std::lock_guard lock{registry_mutex};
+    for (auto& sub : registry) {
+      sub->close();
+    }
+  }
+
+  size_t subscriber_count() {
+    std::lock_guard lock{registry_mutex};
+    return registry.size();
+  }
+};
+
+}  // namespace playground
@@ -0,0 +1,168 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <concepts>
+#include <coroutine>
+#include <cstddef>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+
+#include "async_tool.h"
+
+namespace async {
+
+/**
+ * @brief 并发相同请求的合并 (Request Coalescing)
+ * * 用法: `T value = co_await sf.run(key, factory);`
+ * * 行为: 若 key 没有进行中的调用, 由当前协程 (leader) 启动 `co_await factory()`;
+ * 否则当前协程挂起在该调用的等待链表上. 调用完成后所有等待者以同一个结果 (拷贝) 恢复;
+ * factory 抛出异常时, 所有等待者都会重新抛出该异常. 调用完成后 key 立即失效, 之后的 run
+ * 会重新发起调用 (结果缓存见 async::cache).
+ * * 实现: key 按哈希分片, 分片锁只保护查找 / 插入 / 删除; 等待链表是无锁的 Treiber 栈,
+ * 完成时一次 exchange 关闭链表并取出全部等待者.
+ * @note 等待者在 factory 完成的线程上依次被 resume.
+ */
+template <typename Key, std::copy_constructible T, typename Hash = std::hash<Key>,
+          size_t Shards = 64>
+  requires(Shards > 0)
+class singleflight {
+  struct waiter_node {
+    std::coroutine_handle<> h;
+    waiter_node* next{nullptr};
+  };
+
+  struct call {
+    std::atomic<waiter_node*> waiters{nullptr};
+    value_storage<T> value;
+
+    static waiter_node* closed() noexcept {
+      static waiter_node sentinel{};
+      return &sentinel;
+    }
+
+    /**
+     * @return false 当调用已完成 (链表已关闭), 此时 value 可直接读取
+     */
+    bool push(waiter_node* node) noexcept {
+      waiter_node* head = waiters.load(std::memory_order_acquire);
+      do {
+        if (head == closed()) {
+          return false;
+        }
+        node->next = head;
+      } while (!waiters.compare_exchange_weak(head, node, std::memory_order_release,
+                                              std::memory_order_acquire));
+      return true;
+    }
+
+    /**
+     * @brief 发布结果后调用: 关闭链表并 resume 所有等待者
+     */
+    void complete() {
+      waiter_node* node = waiters.exchange(closed(), std::memory_order_acq_rel);
+      while (node != nullptr) {
+        waiter_node* next = node->next;  // resume 之后 node 所在的协程帧可能已被销毁
+        node->h.resume();
+        node = next;
+      }
+    }
+  };
+
+  struct alignas(64) shard {
+    std::mutex mutex;
+    std::unordered_map<Key, std::shared_ptr<call>, Hash> calls;
+  };
+
+  std::array<shard, Shards> shards;
+
+  shard& shard_of(const Key& key) {
+    return shards[Hash{}(key) % Shards];
+  }
+
+ public:
+  template <typename F>
+  struct awaiter {
+    singleflight& sf;
+    Key key;
+    F factory;
+    std::shared_ptr<call> target;
+    waiter_node node;
+
+    static co_task lead(singleflight& sf, Key key, F factory, std::shared_ptr<call> target) {
+      try {
+        target->value.set(co_await factory());
+      } catch (...) {
+        target->value.e_ptr = std::current_exception();
+      }
+      {
+        auto& s = sf.shard_of(key);
+        std::lock_guard lock{s.mutex};
+        auto it = s.calls.find(key);
+        if (it != s.calls.end() && it->second == target) {
+          s.calls.erase(it);  // 之后的 run 发起新的调用
+        }
+      }
+      target->complete();
+    }
+
+    bool await_ready() const noexcept {
+      return false;
+    }
+
+    bool await_suspend(std::coroutine_handle<> h) {
+      node.h = h;
+      bool leader = false;
+      {
+        auto& s = sf.shard_of(key);
+        std::lock_guard lock{s.mutex};
+        auto [it, inserted] = s.calls.try_emplace(key);
+        if (inserted) {
+          it->second = std::make_shared<call>();
+          leader = true;
+        }
+        target = it->second;
+      }
+      if (!target->push(&node)) {
+        return false;  // 调用刚好完成, 不挂起
+      }
+      if (leader) {
+        // lead 可能同步完成并 resume h, 之后不得再访问 this
+        lead(sf, key, std::move(factory), target).detach();
+      }
+      return true;
+    }
+
+    T await_resume() {
+      return target->value.get();
+    }
+  };
+
+  /**
+   * @param factory 无参可调用对象, 返回 co_await 结果可转换为 T 的 awaitable; 仅 leader 会调用
+   */
+  template <std::invocable F>
+    requires co_awaitable<std::invoke_result_t<F>>
+  awaiter<F> run(Key key, F factory) {
+    return awaiter<F>{.sf = *this, .key = std::move(key), .factory = std::move(factory)};
+  }
+
+  /**
+   * @return 当前进行中的调用数 (仅用于观测, 并发下不精确)
+   */
+  size_t in_flight() {
+    size_t count = 0;
+    for (auto& s : shards) {
+      std::lock_guard lock{s.mutex};
+      count += s.calls.size();
+    }
+    return count;
+  }
+};
+
+}  // namespace async
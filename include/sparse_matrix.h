@@ -0,0 +1,379 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <span>
+#include <stdexcept>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "matrix.h"
+
+namespace playground {
+
+/**
+ * @brief COO 格式的一个非零元
+ */
+template <typename T>
+struct triplet {
+  size_t row;
+  size_t col;
+  T value;
+};
+
+/**
+ * @brief 压缩存储的方向: csr 按行压缩 (major = 行), csc 按列压缩 (major = 列)
+ */
+enum class sparse_layout : uint8_t { csr, csc };
+
+/**
+ * @brief 压缩稀疏矩阵 (CSR / CSC)
+ * * 第 i 条 major (csr 的第 i 行 / csc 的第 i 列) 的非零元为
+ * `indices()[offsets()[i] .. offsets()[i + 1]]` 与对应的 `values()`, 每条 major 内按 minor 下标升序、
+ * 无重复.
+ * * minor 下标以 uint32_t 存储, SpMV 时每个非零元只读 4 + sizeof(T) 字节.
+ */
+template <typename T, sparse_layout Layout = sparse_layout::csr>
+class SparseMatrix {
+ public:
+  using value_type = T;
+  using index_t = uint32_t;
+  static constexpr sparse_layout layout = Layout;
+
+  SparseMatrix() = default;
+
+  SparseMatrix(size_t rows, size_t cols) : n_rows{rows}, n_cols{cols}, offsets_(major_count() + 1) {
+    check_minor_range();
+  }
+
+  /**
+   * @brief 由稠密矩阵构造, 跳过等于 T{} 的元素
+   */
+  explicit SparseMatrix(matrix_view<const T> dense) : SparseMatrix{dense.rows(), dense.cols()} {
+    for (size_t major = 0; major < major_count(); major++) {
+      for (size_t minor = 0; minor < minor_count(); minor++) {
+        const T& value = Layout == sparse_layout::csr ? dense[major, minor] : dense[minor, major];
+        if (value != T{}) {
+          indices_.push_back((index_t)minor);
+          values_.push_back(value);
+        }
+      }
+      offsets_[major + 1] = indices_.size();
+    }
+  }
+
+  /**
+   * @brief 由 COO 三元组构造, 重复的 (row, col) 相加
+   * * 三元组切成 threads 段各自排序, 再两两并行归并 (共 log2(threads) 轮), 最后一次线性扫描
+   * 合并重复元素并生成 offsets.
+   */
+  static SparseMatrix from_triplets(size_t rows, size_t cols, std::vector<triplet<T>> triplets,
+                                    size_t threads = 1) {
+    SparseMatrix result{rows, cols};
+    for (const auto& t : triplets) {
+      if (t.row >= rows || t.col >= cols) {
+        throw std::out_of_range("triplet (row, col) is out of range.");
+      }
+    }
+    sort_triplets(triplets, std::max<size_t>(threads, 1));
+
+    result.indices_.reserve(triplets.size());
+    result.values_.reserve(triplets.size());
+    size_t last_major = 0;
+    for (size_t i = 0; i < triplets.size(); i++) {
+      const size_t major = major_of(triplets[i]);
+      const size_t minor = minor_of(triplets[i]);
+      if (i > 0 && major == major_of(triplets[i - 1]) && minor == minor_of(triplets[i - 1])) {
+        result.values_.back() += triplets[i].value;
+        continue;
+      }
+      for (; last_major < major; last_major++) {
+        result.offsets_[last_major + 1] = result.indices_.size();
+      }
+      result.indices_.push_back((index_t)minor);
+      result.values_.push_back(triplets[i].value);
+    }
+    for (; last_major < result.major_count(); last_major++) {
+      result.offsets_[last_major + 1] = result.indices_.size();
+    }
+    return result;
+  }
+
+  size_t rows() const noexcept {
+    return n_rows;
+  }
+  size_t cols() const noexcept {
+    return n_cols;
+  }
+  size_t nnz() const noexcept {
+    return values_.size();
+  }
+  size_t major_count() const noexcept {
+    return Layout == sparse_layout::csr ? n_rows : n_cols;
+  }
+  size_t minor_count() const noexcept {
+    return Layout == sparse_layout::csr ? n_cols : n_rows;
+  }
+
+  std::span<const size_t> offsets() const noexcept {
+    return offsets_;
+  }
+  std::span<const index_t> indices() const noexcept {
+    return indices_;
+  }
+  std::span<const T> values() const noexcept {
+    return values_;
+  }
+  std::span<T> values() noexcept {
+    return values_;
+  }
+
+  Matrix2D<T> to_dense() const {
+    Matrix2D<T> dense{n_rows, n_cols};
+    for (size_t major = 0; major < major_count(); major++) {
+      for (size_t k = offsets_[major]; k < offsets_[major + 1]; k++) {
+        if constexpr (Layout == sparse_layout::csr) {
+          dense[major, indices_[k]] = values_[k];
+        } else {
+          dense[indices_[k], major] = values_[k];
+        }
+      }
+    }
+    return dense;
+  }
+
+  /**
+   * @brief 转换为另一种压缩方向: 按 minor 下标计数排序, O(nnz + rows + cols)
+   */
+  template <sparse_layout To>
+  SparseMatrix<T, To> convert() const {
+    if constexpr (To == Layout) {
+      return *this;
+    } else {
+      SparseMatrix<T, To> result{n_rows, n_cols};
+      auto& offsets = result.offsets_;
+      for (index_t minor : indices_) {
+        offsets[minor + 1]++;
+      }
+      for (size_t i = 0; i < minor_count(); i++) {
+        offsets[i + 1] += offsets[i];
+      }
+      result.indices_.resize(nnz());
+      result.values_.resize(nnz());
+      std::vector<size_t> cursor(offsets.begin(), offsets.end() - 1);
+      // 按 major 升序扫描, 写入后每条新 major 内的下标自然有序
+      for (size_t major = 0; major < major_count(); major++) {
+        for (size_t k = offsets_[major]; k < offsets_[major + 1]; k++) {
+          const size_t slot = cursor[indices_[k]]++;
+          result.indices_[slot] = (index_t)major;
+          result.values_[slot] = values_[k];
+        }
+      }
+      return result;
+    }
+  }
+
+  SparseMatrix<T, sparse_layout::csr> to_csr() const {
+    return convert<sparse_layout::csr>();
+  }
+  SparseMatrix<T, sparse_layout::csc> to_csc() const {
+    return convert<sparse_layout::csc>();
+  }
+
+ private:
+  size_t n_rows{};
+  size_t n_cols{};
+  std::vector<size_t> offsets_{0};
+  std::vector<index_t> indices_;
+  std::vector<T> values_;
+
+  template <typename U, sparse_layout L>
+  friend class SparseMatrix;
+
+  void check_minor_range() const {
+    if (minor_count() > (size_t)std::numeric_limits<index_t>::max()) {
+      throw std::length_error("sparse matrix minor dimension exceeds uint32_t.");
+    }
+  }
+
+  static size_t major_of(const triplet<T>& t) noexcept {
+    return Layout == sparse_layout::csr ? t.row : t.col;
+  }
+  static size_t minor_of(const triplet<T>& t) noexcept {
+    return Layout == sparse_layout::csr ? t.col : t.row;
+  }
+
+  static void sort_triplets(std::vector<triplet<T>>& triplets, size_t threads) {
+    const auto less = [](const triplet<T>& a, const triplet<T>& b) {
+      return std::pair{major_of(a), minor_of(a)} < std::pair{major_of(b), minor_of(b)};
+    };
+    const size_t n = triplets.size();
+    threads = std::min(threads, std::max<size_t>(n / 4096, 1));
+    if (threads == 1) {
+      std::sort(triplets.begin(), triplets.end(), less);
+      return;
+    }
+    std::vector<size_t> bounds(threads + 1);
+    for (size_t i = 0; i <= threads; i++) {
+      bounds[i] = n * i / threads;
+    }
+    auto at = [&](size_t i) { return triplets.begin() + (std::ptrdiff_t)bounds[i]; };
+    {
+      std::vector<std::jthread> workers;
+      for (size_t i = 0; i < threads; i++) {
+        workers.emplace_back([&, i]() { std::sort(at(i), at(i + 1), less); });
+      }
+    }
+    // 每轮把相邻的两段归并为一段
+    for (size_t width = 1; width < threads; width *= 2) {
+      std::vector<std::jthread> workers;
+      for (size_t i = 0; i + width < threads; i += 2 * width) {
+        const size_t last = std::min(i + 2 * width, threads);
+        workers.emplace_back([&, i, width, last]() {
+          std::inplace_merge(at(i), at(i + width), at(last), less);
+        });
+      }
+    }
+  }
+};
+
+template <typename T>
+using csr_matrix = SparseMatrix<T, sparse_layout::csr>;
+
+template <typename T>
+using csc_matrix = SparseMatrix<T, sparse_layout::csc>;
+
+/**
+ * @brief y = A * x (CSR) 中第 [row_begin, row_end) 行的部分, 供串行与并行的 SpMV 共用
+ */
+template <typename T>
+void multiply_rows(const csr_matrix<T>& a, std::span<const T> x, std::span<T> y, size_t row_begin,
+                   size_t row_end) {
+  const size_t* offsets = a.offsets().data();
+  const uint32_t* indices = a.indices().data();
+  const T* values = a.values().data();
+  for (size_t r = row_begin; r < row_end; r++) {
+    T sum{};
+    for (size_t k = offsets[r]; k < offsets[r + 1]; k++) {
+      sum += values[k] * x[indices[k]];
+    }
+    y[r] = sum;
+  }
+}
+
+/**
+ * @brief SpMV: y = A * x
+ * * CSR 逐行做稀疏点积; CSC 逐列把 x[j] 乘以该列累加到 y (scatter)
+ * * T 只从 A 推导, x / y 可以直接传 std::vector 等连续容器
+ */
+template <typename T, sparse_layout Layout>
+void multiply(const SparseMatrix<T, Layout>& a, std::type_identity_t<std::span<const T>> x,
+              std::type_identity_t<std::span<T>> y) {
+  if (x.size() != a.cols() || y.size() != a.rows()) {
+    throw std::invalid_argument("matrix and vector dimensions do not match.");
+  }
+  if constexpr (Layout == sparse_layout::csr) {
+    multiply_rows(a, x, y, 0, a.rows());
+  } else {
+    std::fill(y.begin(), y.end(), T{});
+    const auto offsets = a.offsets();
+    const auto indices = a.indices();
+    const auto values = a.values();
+    for (size_t c = 0; c < a.cols(); c++) {
+      const T xc = x[c];
+      for (size_t k = offsets[c]; k < offsets[c + 1]; k++) {
+        y[indices[k]] += values[k] * xc;
+      }
+    }
+  }
+}
+
+template <typename T, sparse_layout Layout>
+std::vector<T> multiply(const SparseMatrix<T, Layout>& a,
+                        std::type_identity_t<std::span<const T>> x) {
+  std::vector<T> y(a.rows());
+  multiply(a, x, y);
+  return y;
+}
+
+/**
+ * @brief SpMM: C = A * B, A 稀疏, B 稠密
+ * * 每个非零元 A(i, j) 把 B 的第 j 行乘以 A(i, j) 累加到 C 的第 i 行, 内层是连续的行 axpy
+ */
+template <typename T, sparse_layout Layout>
+Matrix2D<T> multiply(const SparseMatrix<T, Layout>& a,
+                     std::type_identity_t<matrix_view<const T>> b) {
+  if (a.cols() != b.rows()) {
+    throw std::invalid_argument("matrix dimensions do not match.");
+  }
+  Matrix2D<T> c{a.rows(), b.cols()};
+  const auto offsets = a.offsets();
+  const auto indices = a.indices();
+  const auto values = a.values();
+  const size_t n = b.cols();
+  for (size_t major = 0; major < a.major_count(); major++) {
+    for (size_t k = offsets[major]; k < offsets[major + 1]; k++) {
+      const size_t i = Layout == sparse_layout::csr ? major : indices[k];
+      const size_t j = Layout == sparse_layout::csr ? indices[k] : major;
+      const T v = values[k];
+      T* dst = c.data() + i * c.stride();
+      const T* src = b.data() + j * b.stride();
+      for (size_t col = 0; col < n; col++) {
+        dst[col] += v * src[col];
+      }
+    }
+  }
+  return c;
+}
+
+/**
+ * @brief C = B * A, B 稠密, A 稀疏
+ * * CSR: B(i, k) 乘以 A 的第 k 行累加到 C 的第 i 行; CSC: C(i, j) 是 B 的第 i 行与 A 第 j 列的稀疏点积
+ */
+template <typename T, sparse_layout Layout>
+Matrix2D<T> multiply(std::type_identity_t<matrix_view<const T>> b,
+                     const SparseMatrix<T, Layout>& a) {
+  if (b.cols() != a.rows()) {
+    throw std::invalid_argument("matrix dimensions do not match.");
+  }
+  Matrix2D<T> c{b.rows(), a.cols()};
+  const auto offsets = a.offsets();
+  const auto indices = a.indices();
+  const auto values = a.values();
+  for (size_t i = 0; i < b.rows(); i++) {
+    const T* src = b.data() + i * b.stride();
+    T* dst = c.data() + i * c.stride();
+    for (size_t major = 0; major < a.major_count(); major++) {
+      if constexpr (Layout == sparse_layout::csr) {
+        const T bik = src[major];
+        for (size_t k = offsets[major]; k < offsets[major + 1]; k++) {
+          dst[indices[k]] += bik * values[k];
+        }
+      } else {
+        T sum{};
+        for (size_t k = offsets[major]; k < offsets[major + 1]; k++) {
+          sum += src[indices[k]] * values[k];
+        }
+        dst[major] = sum;
+      }
+    }
+  }
+  return c;
+}
+
+template <typename T, sparse_layout Layout>
+Matrix2D<T> multiply(const SparseMatrix<T, Layout>& a, const Matrix2D<T>& b) {
+  return multiply(a, b.view());
+}
+
+template <typename T, sparse_layout Layout>
+Matrix2D<T> multiply(const Matrix2D<T>& b, const SparseMatrix<T, Layout>& a) {
+  return multiply(b.view(), a);
+}
+
+}  // namespace playground
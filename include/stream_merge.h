@@ -0,0 +1,303 @@
+#pragma once
+
+#include <chrono>
+#include <concepts>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <iterator>
+#include <optional>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "concurrency_utils.h"
+
+namespace playground {
+
+/**
+ * @brief 可以被 stream_merger 批量拉取的 stream (如 sync_stream)
+ */
+template <typename S>
+concept pullable_stream =
+    requires(S& stream, std::back_insert_iterator<std::deque<typename S::msg_t>> out) {
+      { stream.try_read_many(out, size_t{}) } -> std::convertible_to<size_t>;
+      { static_cast<bool>(stream) };
+    };
+
+/**
+ * @brief 按时间戳排序, 没有时间戳的消息视为最早
+ */
+struct by_timestamp {
+  template <typename T>
+  std::chrono::nanoseconds operator()(const T& msg) const noexcept {
+    return msg.timestamp ? std::chrono::duration_cast<std::chrono::nanoseconds>(
+                               msg.timestamp->time_since_epoch())
+                         : std::chrono::nanoseconds{0};
+  }
+};
+
+/**
+ * @brief 按序列号排序, 要求各个 stream 的序列号来自同一个生成器
+ */
+struct by_serial {
+  template <typename T>
+  int64_t operator()(const T& msg) const noexcept {
+    return static_cast<int64_t>(msg.serial_number);
+  }
+};
+
+enum class late_policy : std::uint8_t {
+  emit,  // 迟到的消息照常输出 (此时输出不再有序)
+  drop,  // 丢弃迟到的消息并计数
+};
+
+template <typename K>
+struct merge_options {
+  K allowed_lateness{};                          // 水位线 = 已见到的最大 key - allowed_lateness
+  std::chrono::microseconds idle_timeout{1000};  // 超过该时长没有进展时, 不再等待空的 stream
+  size_t batch{64};                              // 每次从一个 stream 拉取的最大消息数
+  late_policy late{late_policy::drop};
+};
+
+/**
+ * @brief N 路有序合并: 从 N 个各自有序的 stream 中读取, 输出一个按 key 全局有序的 stream
+ * * 选择: 败者树 (loser tree), 每输出一条消息只需沿一条路径 O(log N) 次比较;
+ * 每个源在本地缓冲区为空时才拉取, 一次至多拉取 batch 条.
+ * * 水位线: 所有仍打开的源都有缓冲时, 直接输出最小者; 某个源暂时为空时, 只输出
+ * key <= max_seen - allowed_lateness 的消息; 整体超过 idle_timeout 没有进展时不再等待空源.
+ * 之后才到达且 key 小于已输出 key 的消息为迟到消息, 按 late_policy 处理.
+ * * 结束: 所有源都已停止且读空后, read_sync 返回 empty.
+ * @note 单消费者使用 (非线程安全); 源为空时以 yield / 短暂 sleep 轮询
+ */
+template <pullable_stream Stream, typename KeyFn = by_timestamp>
+class stream_merger {
+ public:
+  using msg_t = typename Stream::msg_t;
+  using key_t = std::invoke_result_t<KeyFn, const msg_t&>;
+  using status = sync_stream_read_write_status;  // template params independent
+
+ private:
+  struct source {
+    Stream* stream;
+    std::deque<msg_t> buffer;
+    bool open{true};
+  };
+
+  std::vector<source> sources;
+  std::vector<size_t> tree;  // tree[0] 为胜者, tree[1..leaves) 为各内部节点的败者
+  size_t leaves{1};
+  [[no_unique_address]] KeyFn key_of{};
+  merge_options<key_t> options;
+  std::optional<key_t> max_seen;
+  std::optional<key_t> last_emitted;
+  size_t late_count{0};
+  size_t waiting{0};  // 打开但缓冲为空的源的数量
+  std::chrono::steady_clock::time_point last_progress{std::chrono::steady_clock::now()};
+
+  bool has_head(size_t i) const noexcept {
+    return i < sources.size() && !sources[i].buffer.empty();
+  }
+
+  /**
+   * @brief 缓冲为空的源视为 +inf; key 相同时按源的下标, 保证稳定
+   */
+  bool less(size_t a, size_t b) const {
+    if (!has_head(a) || !has_head(b)) {
+      return has_head(a);
+    }
+    const key_t ka = key_of(sources[a].buffer.front());
+    const key_t kb = key_of(sources[b].buffer.front());
+    return ka < kb || (!(kb < ka) && a < b);
+  }
+
+  void build() {
+    std::vector<size_t> winners(2 * leaves);
+    for (size_t node = 2 * leaves - 1; node >= 1; node--) {
+      if (node >= leaves) {
+        winners[node] = node - leaves;
+        continue;
+      }
+      const size_t l = winners[2 * node];
+      const size_t r = winners[2 * node + 1];
+      winners[node] = less(r, l) ? r : l;
+      tree[node] = less(r, l) ? l : r;
+    }
+    tree[0] = winners[1];
+  }
+
+  /**
+   * @brief 胜者 i 的队首变化后, 沿叶子到根的路径重新比较
+   */
+  void replay(size_t i) {
+    size_t winner = i;
+    for (size_t node = (i + leaves) / 2; node >= 1; node /= 2) {
+      if (less(tree[node], winner)) {
+        std::swap(tree[node], winner);
+      }
+    }
+    tree[0] = winner;
+  }
+
+  /**
+   * @brief 从源 i 拉取一批消息 (仅在其缓冲为空时调用)
+   * @return 是否拉取到消息
+   */
+  bool pull(size_t i) {
+    auto& src = sources[i];
+    if (src.stream->try_read_many(std::back_inserter(src.buffer), options.batch) == 0) {
+      if (!*src.stream) {
+        src.open = false;
+        waiting--;
+      }
+      return false;
+    }
+    const key_t back = key_of(src.buffer.back());
+    if (!max_seen || *max_seen < back) {
+      max_seen = back;
+    }
+    waiting--;
+    return true;
+  }
+
+  /**
+   * @brief 尝试为所有等待中的源拉取消息
+   * @return 是否有进展 (拉取到消息或有源结束)
+   * @note replay 只适用于胜者所在的叶子, 非胜者的叶子变化后需要重建整棵树;
+   *       每个源每拉取一批才重建一次, 均摊到每条消息为 O(N / batch)
+   */
+  bool poll_waiting() {
+    bool pulled = false;
+    const size_t before = waiting;
+    for (size_t i = 0; i < sources.size(); i++) {
+      if (sources[i].open && sources[i].buffer.empty()) {
+        pulled = pull(i) || pulled;
+      }
+    }
+    if (pulled) {
+      build();
+    }
+    return waiting != before;
+  }
+
+  bool may_emit(const key_t& key) const {
+    if (waiting == 0) {
+      return true;
+    }
+    if (max_seen && key <= *max_seen - options.allowed_lateness) {
+      return true;
+    }
+    return std::chrono::steady_clock::now() - last_progress > options.idle_timeout;
+  }
+
+  /**
+   * @brief 取出胜者的队首; 迟到且按 drop 处理时返回 nullopt
+   */
+  std::optional<msg_t> pop_winner() {
+    const size_t i = tree[0];
+    auto& src = sources[i];
+    std::optional<msg_t> msg{std::move(src.buffer.front())};
+    src.buffer.pop_front();
+    if (src.buffer.empty()) {
+      waiting++;
+      pull(i);
+    }
+    replay(i);
+    last_progress = std::chrono::steady_clock::now();
+    const key_t key = key_of(*msg);
+    if (last_emitted && key < *last_emitted) {
+      late_count++;
+      if (options.late == late_policy::drop) {
+        return std::nullopt;
+      }
+      return msg;
+    }
+    last_emitted = key;
+    return msg;
+  }
+
+ public:
+  /**
+   * @param streams 被合并的 stream, 生命周期须覆盖 merger
+   */
+  explicit stream_merger(std::vector<Stream*> streams, merge_options<key_t> options = {})
+      : options{options} {
+    sources.reserve(streams.size());
+    for (Stream* stream : streams) {
+      sources.push_back(source{.stream = stream});
+    }
+    while (leaves < sources.size()) {
+      leaves *= 2;
+    }
+    tree.resize(leaves);
+    waiting = sources.size();
+    build();
+  }
+
+  /**
+   * @brief 阻塞到至少输出一条消息或所有源结束, 之后至多输出 max 条
+   * @return 输出的消息数, 0 表示所有源都已结束
+   */
+  template <std::output_iterator<msg_t&&> Out>
+  size_t read_many(Out output, size_t max) {
+    size_t count = 0;
+    size_t idle_rounds = 0;
+    while (count < max) {
+      if (has_head(tree[0]) && may_emit(key_of(sources[tree[0]].buffer.front()))) {
+        if (auto msg = pop_winner()) {
+          *output++ = std::move(*msg);
+          count++;
+        }
+        idle_rounds = 0;
+        continue;
+      }
+      if (waiting == 0 && !has_head(tree[0])) {
+        break;  // 所有源都已结束
+      }
+      if (poll_waiting()) {
+        idle_rounds = 0;
+        last_progress = std::chrono::steady_clock::now();
+        continue;
+      }
+      if (count != 0) {
+        break;  // 不为凑满一批而等待
+      }
+      if (++idle_rounds < 64) {
+        std::this_thread::yield();
+      } else {
+        std::this_thread::sleep_for(std::chrono::microseconds{50});
+      }
+    }
+    return count;
+  }
+
+  status read_sync(msg_t& data) {
+    return read_many(&data, 1) != 0 ? status::good : status::empty;
+  }
+
+  status operator>>(msg_t& data) {
+    return read_sync(data);
+  }
+
+  operator bool() const noexcept {
+    return waiting != 0 || has_head(tree[0]);
+  }
+
+  /**
+   * @return 迟到的消息数 (无论是否被丢弃)
+   */
+  size_t late() const noexcept {
+    return late_count;
+  }
+
+  std::optional<key_t> watermark() const {
+    if (!max_seen) {
+      return std::nullopt;
+    }
+    return *max_seen - options.allowed_lateness;
+  }
+};
+
+}  // namespace playground
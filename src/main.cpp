@@ -9,11 +9,30 @@ int main() {
   playground::try_concurrency();
   playground::try_mutex();
   playground::play_with_matrix();
+  playground::try_matrix_layout();
+  playground::try_matrix_multiply();
+  playground::try_matrix_parallel();
+  playground::try_matrix_expr();
+  playground::try_matrix_transpose();
+  playground::try_matrix_file();
+  playground::try_sparse_matrix();
   playground::try_shared_mutex();
   playground::try_condition_variable();
   playground::try_condition_variable_with_stop();
   playground::try_message();
   playground::try_msg_stream();
+  playground::try_msg_stream2();
+  playground::try_msg_stream3();
+  playground::try_msg_stream4();
+  playground::try_msg_stream5();
+  playground::try_msg_stream6();
+  playground::try_msg_stream7();
+  playground::try_msg_stream8();
+  playground::try_msg_stream9();
+  playground::try_msg_codec();
+  playground::try_msg_arena();
+  playground::try_msg_router();
+  playground::try_msg_batch();
   playground::try_coroutine();
   playground::try_toy_queue();
   playground::try_toy_queue2();
@@ -36,5 +55,10 @@ int main() {
   playground::try_await14();
   playground::try_await15();
   playground::try_await16();
+  playground::try_await17();
+  playground::try_await18();
+  playground::try_await19();
+  playground::try_await20();
+  playground::try_await21();
   return 0;
 }
\ No newline at end of file
@@ -0,0 +1,105 @@
+// 编译期基准: 对 50 / 200 / 500 个分支的 variant 做 valid_msg_variant 检查,
+// 并对每个分支做一次 type_in_variant 查找 (相当于每个 get<T> / on<T> 调用点).
+// 不在默认构建中, 用 -ftime-report 或计时比较两个目标:
+//   cmake --build build --target message_meta_bench          (message.h 中的实现)
+//   cmake --build build --target message_meta_bench_legacy   (原先的递归 / O(n^2) 实现)
+#include <cstddef>
+#include <type_traits>
+#include <utility>
+#include <variant>
+
+#include "message.h"
+
+#ifdef MSG_META_LEGACY
+namespace legacy {
+
+using msg::index_not_found;
+
+template <typename T, typename... Ts>
+struct index_of_ {
+  static constexpr size_t value = index_not_found;
+};
+
+template <typename T, typename... Ts>
+struct index_of_<T, T, Ts...> {
+  static constexpr size_t value = 0;
+};
+
+template <typename T1, typename T2, typename... Ts>
+struct index_of_<T1, T2, Ts...> {
+  using sub = index_of_<T1, Ts...>;
+  static constexpr size_t value =
+      (sub::value == index_not_found) ? index_not_found : (sub::value + 1);
+};
+
+template <typename T, typename V>
+struct type_in_variant_;
+
+template <typename T, typename... Ts>
+struct type_in_variant_<T, std::variant<Ts...>> {
+  static constexpr size_t index = index_of_<T, Ts...>::value;
+};
+
+template <typename T, typename V>
+concept type_in_variant = (type_in_variant_<T, V>::index != index_not_found);
+
+template <typename T, typename... Ts>
+struct same_t_count {
+  static constexpr size_t value =
+      ((size_t)0 + ... + (std::is_same_v<T, Ts> ? (size_t)1 : (size_t)0));
+};
+
+template <typename... Ts>
+struct no_dup {
+  static constexpr bool value = (true && ... && (same_t_count<Ts, Ts...>::value == (size_t)1));
+};
+
+template <typename T>
+struct no_dup_variant_ : public std::false_type {};
+
+template <typename... Ts>
+  requires no_dup<Ts...>::value
+struct no_dup_variant_<std::variant<Ts...>> : public std::true_type {};
+
+template <typename V>
+concept valid_msg_variant =
+    msg::some_variant<V> && msg::variant_start_with_monostate<V> && no_dup_variant_<V>::value;
+
+}  // namespace legacy
+
+namespace impl = legacy;
+#else
+namespace impl = msg;
+#endif
+
+namespace {
+
+template <size_t Tag, size_t I>
+struct alt {};
+
+template <size_t Tag, typename Seq>
+struct big_variant_;
+
+template <size_t Tag, size_t... Is>
+struct big_variant_<Tag, std::index_sequence<Is...>> {
+  using type = std::variant<std::monostate, alt<Tag, Is>...>;
+  using dup_type = std::variant<std::monostate, alt<Tag, Is>..., alt<Tag, 0>>;
+
+  static constexpr bool all_found = (true && ... && impl::type_in_variant<alt<Tag, Is>, type>);
+};
+
+template <size_t N>
+constexpr bool check() {
+  using big = big_variant_<N, std::make_index_sequence<N>>;
+  static_assert(impl::valid_msg_variant<typename big::type>);
+  static_assert(!impl::valid_msg_variant<typename big::dup_type>);
+  static_assert(big::all_found);
+  static_assert(!impl::type_in_variant<alt<N, N>, typename big::type>);
+  return true;
+}
+
+static_assert(check<50>());
+static_assert(check<200>());
+static_assert(check<500>());
+
+}  // namespace
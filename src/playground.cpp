@@ -4,17 +4,23 @@
 #include <algorithm>
 #include <atomic>
 #include <chrono>
+#include <cmath>
 #include <concepts>
 #include <condition_variable>
 #include <cstddef>
 #include <cstdint>
+#include <cstdlib>
 #include <exception>
+#include <filesystem>
+#include <fstream>
 #include <functional>
 #include <future>
 #include <initializer_list>
 #include <iostream>
+#include <latch>
 #include <locale>
 #include <memory>
+#include <memory_resource>
 #include <mutex>
 #include <optional>
 #include <ostream>
@@ -24,6 +30,7 @@
 #include <ratio>
 #include <semaphore>
 #include <shared_mutex>
+#include <span>
 #include <stdexcept>
 #include <stop_token>
 #include <string_view>
@@ -33,7 +40,22 @@
 #include <utility>
 #include <variant>
 
+#include "async_cache.h"
+#include "matrix_expr.h"
+#include "matrix_file.h"
+#include "matrix_multiply.h"
+#include "matrix_parallel.h"
+#include "matrix_transpose.h"
 #include "message.h"
+#include "message_arena.h"
+#include "message_batch.h"
+#include "message_codec.h"
+#include "message_router.h"
+#include "persistent_stream.h"
+#include "pubsub.h"
+#include "singleflight.h"
+#include "sparse_matrix.h"
+#include "stream_merge.h"
 #include "toyqueue.h"
 #include "async_tool.h"
 
@@ -152,6 +174,695 @@ void play_with_matrix() {
   Matrix2D<double> n(m);
   n[0, 0] = 3.14;
   std::cout << n << std::endl;
+
+  // 视图与矩阵共享内存
+  std::ranges::fill(m.row(0), 0);
+  std::ranges::fill(m.col(3), 7);
+  auto sub = m.block(1, 1, 2, 2);
+  sub[0, 0] = 100;
+  std::cout << m << std::endl;
+  std::cout << Matrix2D<int>{sub} << std::endl;
+}
+
+namespace {
+
+/**
+ * @brief 原先的布局: 每行单独分配, 访问时检查下标, 作为 try_matrix_layout 的对照
+ */
+template <typename T>
+struct row_ptr_matrix {
+  row_ptr_matrix(size_t row, size_t col) : row{row}, col{col} {
+    data = std::unique_ptr<std::unique_ptr<T[]>[]>{new std::unique_ptr<T[]>[row] {}};
+    for (size_t r = 0; r < row; r++) {
+      data[r] = std::unique_ptr<T[]>{new T[col]{}};
+    }
+  }
+
+  row_ptr_matrix(const row_ptr_matrix& other) : row_ptr_matrix{other.row, other.col} {
+    for (size_t r = 0; r < row; r++) {
+      std::copy(other.data[r].get(), other.data[r].get() + col, data[r].get());
+    }
+  }
+
+  T& operator[](size_t r, size_t c) {
+    if (data) {
+      if (r < row && c < col) {
+        return data[r][c];
+      }
+      throw std::runtime_error("index (r, c) is out of range.");
+    }
+    throw std::runtime_error("data of Matrix2D is nullptr.");
+  }
+
+  std::unique_ptr<std::unique_ptr<T[]>[]> data{};
+  size_t row{};
+  size_t col{};
+};
+
+}  // namespace
+
+void try_matrix_layout() {
+  auto bench = [](size_t row, size_t col) {
+    const int rounds = std::max(1, (int)(64'000'000 / (row * col)));
+    auto report = [&](std::string tag, long long check, auto time) {
+      const double seconds = std::chrono::duration<double>(time).count();
+      std::cout << std::format("[{:>5} x {:<5}] {} check = {}, {:.2f} G elem/s\n", row, col, tag,
+                               check, (double)row * col * rounds / seconds / 1e9)
+                << std::flush;
+    };
+
+    row_ptr_matrix<int> old_m{row, col};
+    Matrix2D<int> new_m{row, col};
+    for (size_t r = 0; r < row; r++) {
+      for (size_t c = 0; c < col; c++) {
+        old_m[r, c] = new_m[r, c] = (int)((r * 31 + c) % 97);
+      }
+    }
+
+    long long sum = 0;
+    auto time = timer_wrap([&]() {
+      for (int k = 0; k < rounds; k++) {
+        for (size_t r = 0; r < row; r++) {
+          for (size_t c = 0; c < col; c++) {
+            sum += old_m[r, c];
+          }
+        }
+      }
+    })();
+    report("row-ptr   traverse (r, c)", sum, time);
+
+    sum = 0;
+    time = timer_wrap([&]() {
+      for (int k = 0; k < rounds; k++) {
+        for (size_t r = 0; r < row; r++) {
+          for (size_t c = 0; c < col; c++) {
+            sum += new_m[r, c];
+          }
+        }
+      }
+    })();
+    report("strided   traverse (r, c)", sum, time);
+
+    sum = 0;
+    time = timer_wrap([&]() {
+      for (int k = 0; k < rounds; k++) {
+        for (size_t r = 0; r < row; r++) {
+          for (int item : new_m.row(r)) {
+            sum += item;
+          }
+        }
+      }
+    })();
+    report("strided   traverse row(r)", sum, time);
+
+    sum = 0;
+    time = timer_wrap([&]() {
+      for (int k = 0; k < rounds; k++) {
+        for (size_t c = 0; c < col; c++) {
+          for (size_t r = 0; r < row; r++) {
+            sum += old_m[r, c];
+          }
+        }
+      }
+    })();
+    report("row-ptr   traverse (c, r)", sum, time);
+
+    sum = 0;
+    time = timer_wrap([&]() {
+      for (int k = 0; k < rounds; k++) {
+        for (size_t c = 0; c < col; c++) {
+          for (int item : new_m.col(c)) {
+            sum += item;
+          }
+        }
+      }
+    })();
+    report("strided   traverse col(c)", sum, time);
+
+    sum = 0;
+    time = timer_wrap([&]() {
+      for (int k = 0; k < rounds; k++) {
+        row_ptr_matrix<int> copy{old_m};
+        sum += copy[row - 1, col - 1];
+      }
+    })();
+    report("row-ptr   copy-construct ", sum, time);
+
+    sum = 0;
+    time = timer_wrap([&]() {
+      for (int k = 0; k < rounds; k++) {
+        Matrix2D<int> copy{new_m};
+        sum += copy[row - 1, col - 1];
+      }
+    })();
+    report("strided   copy-construct ", sum, time);
+  };
+
+  bench(16, 16);
+  bench(1000, 10);
+  bench(1000, 1000);
+  bench(4000, 4000);
+}
+
+void try_matrix_multiply() {
+  auto naive_multiply = []<typename T>(const Matrix2D<T>& a, const Matrix2D<T>& b) {
+    Matrix2D<T> c{a.rows(), b.cols()};
+    for (size_t i = 0; i < a.rows(); i++) {
+      for (size_t j = 0; j < b.cols(); j++) {
+        T sum{};
+        for (size_t p = 0; p < a.cols(); p++) {
+          sum += a[i, p] * b[p, j];
+        }
+        c[i, j] = sum;
+      }
+    }
+    return c;
+  };
+
+  auto bench = [&]<typename T>(std::string type_name, size_t n) {
+    Matrix2D<T> a{n, n};
+    Matrix2D<T> b{n, n};
+    std::mt19937 gen{42};
+    for (size_t i = 0; i < n; i++) {
+      for (size_t j = 0; j < n; j++) {
+        a[i, j] = (T)(int)(gen() % 17) - 8;
+        b[i, j] = (T)(int)(gen() % 17) - 8;
+      }
+    }
+    const double flops = 2.0 * n * n * n;
+    const int rounds = std::max(1, (int)(4e9 / flops));
+    auto gflops = [&](auto time, int rounds) {
+      return flops * rounds / std::chrono::duration<double>(time).count() / 1e9;
+    };
+
+    Matrix2D<T> c;
+    auto time = timer_wrap([&]() {
+      for (int k = 0; k < rounds; k++) {
+        c = multiply(a, b);
+      }
+    })();
+    const double best = gflops(time, rounds);
+
+    Matrix2D<T> c_portable{n, n};
+    time = timer_wrap([&]() {
+      for (int k = 0; k < rounds; k++) {
+        multiply_add<T>(c_portable.view(), a.view(), b.view(),
+                        gemm_kernel_for<T>(simd_level::portable));
+      }
+    })();
+    const double portable = gflops(time, rounds);
+
+    std::string naive = "skipped";
+    if (n <= 1024) {
+      Matrix2D<T> expected;
+      time = timer_wrap([&]() { expected = naive_multiply(a, b); })();
+      bool same = true;
+      for (size_t i = 0; i < n && same; i++) {
+        same = std::ranges::equal(c.row(i), expected.row(i));
+      }
+      naive = std::format("{:7.2f} GFLOP/s{}", gflops(time, 1), same ? "" : " MISMATCH");
+    }
+    std::cout << std::format("[{:<6} {:>4}] kernel {:7.2f} GFLOP/s, portable {:7.2f} GFLOP/s, "
+                             "naive {}\n",
+                             type_name, n, best, portable, naive)
+              << std::flush;
+  };
+
+  std::cout << std::format("simd level: {}\n", (int)detect_simd_level());
+  for (size_t n = 64; n <= 4096; n *= 2) {
+    bench.operator()<float>("float", n);
+    bench.operator()<double>("double", n);
+    bench.operator()<int32_t>("int32", n);
+  }
+}
+
+namespace {
+
+template <size_t I, typename L>
+auto matrix_chain_op(L&& lhs, const Matrix2D<float>& rhs) {
+  if constexpr (I % 3 == 1) {
+    return std::forward<L>(lhs) + rhs;
+  } else if constexpr (I % 3 == 2) {
+    return std::forward<L>(lhs) - rhs;
+  } else {
+    return hadamard(std::forward<L>(lhs), rhs);
+  }
+}
+
+/**
+ * @brief ms[0] op1 ms[1] op2 ... opK ms[K] 的惰性表达式, op 依次为 +, -, hadamard
+ */
+template <size_t I, size_t K, typename L>
+auto fused_matrix_chain(L lhs, const std::vector<Matrix2D<float>>& ms) {
+  if constexpr (I > K) {
+    return lhs;
+  } else {
+    return fused_matrix_chain<I + 1, K>(matrix_chain_op<I>(std::move(lhs), ms[I]), ms);
+  }
+}
+
+/**
+ * @brief 同样的运算, 每一步都求值成一个临时矩阵 (即逐个运算符求值的做法)
+ */
+template <size_t I, size_t K>
+Matrix2D<float> eager_matrix_chain(const Matrix2D<float>& lhs,
+                                   const std::vector<Matrix2D<float>>& ms) {
+  Matrix2D<float> next = matrix_chain_op<I>(lhs, ms[I]);
+  if constexpr (I == K) {
+    return next;
+  } else {
+    return eager_matrix_chain<I + 1, K>(next, ms);
+  }
+}
+
+}  // namespace
+
+void try_matrix_expr() {
+  const size_t n = 2048;
+  const double matrix_bytes = (double)n * n * sizeof(float);
+  std::vector<Matrix2D<float>> ms;
+  std::mt19937 gen{42};
+  for (int k = 0; k <= 6; k++) {
+    Matrix2D<float> m{n, n};
+    for (size_t i = 0; i < n; i++) {
+      for (float& item : m.row(i)) {
+        item = (float)(gen() % 1000) / 100.0f;
+      }
+    }
+    ms.push_back(std::move(m));
+  }
+  handle_runner pool{16, std::max(1u, std::thread::hardware_concurrency())};
+
+  auto bench = [&]<size_t K>() {
+    const int rounds = 5;
+    Matrix2D<float> eager;
+    auto time = timer_wrap([&]() {
+      for (int k = 0; k < rounds; k++) {
+        eager = eager_matrix_chain<1, K>(ms[0], ms);
+      }
+    })();
+    const double eager_seconds = std::chrono::duration<double>(time).count() / rounds;
+
+    Matrix2D<float> fused{n, n};
+    time = timer_wrap([&]() {
+      for (int k = 0; k < rounds; k++) {
+        fused = fused_matrix_chain<1, K>(as_expr(ms[0]), ms);
+      }
+    })();
+    const double fused_seconds = std::chrono::duration<double>(time).count() / rounds;
+
+    Matrix2D<float> parallel{n, n};
+    time = timer_wrap([&]() {
+      [&]() -> async::co_task {
+        for (int k = 0; k < rounds; k++) {
+          co_await async::parallel_assign(parallel.view(), fused_matrix_chain<1, K>(as_expr(ms[0]), ms),
+                                          pool);
+        }
+      }()
+                  .get_future()
+                  .get();
+    })();
+    const double parallel_seconds = std::chrono::duration<double>(time).count() / rounds;
+
+    bool same = true;
+    for (size_t i = 0; i < n && same; i++) {
+      same = std::ranges::equal(eager.row(i), fused.row(i)) &&
+             std::ranges::equal(parallel.row(i), fused.row(i));
+    }
+    // 估算的内存流量: 逐个求值时每个二元运算读两个矩阵写一个, 融合后每个输入只读一次
+    const double eager_traffic = 3.0 * K * matrix_bytes;
+    const double fused_traffic = (K + 2.0) * matrix_bytes;
+    std::cout << std::format("[{} ops] eager {:6.2f} ms ({:4.0f} MB), fused {:6.2f} ms ({:4.0f} MB), "
+                             "parallel fused {:6.2f} ms{}\n",
+                             K, eager_seconds * 1e3, eager_traffic / 1e6, fused_seconds * 1e3,
+                             fused_traffic / 1e6, parallel_seconds * 1e3, same ? "" : " MISMATCH")
+              << std::flush;
+  };
+
+  bench.operator()<2>();
+  bench.operator()<3>();
+  bench.operator()<4>();
+  bench.operator()<5>();
+  bench.operator()<6>();
+}
+
+void try_matrix_parallel() {
+  const size_t hardware_threads = std::max(1u, std::thread::hardware_concurrency());
+  std::vector<size_t> thread_counts;
+  for (size_t threads = 1; threads < hardware_threads; threads *= 2) {
+    thread_counts.push_back(threads);
+  }
+  thread_counts.push_back(hardware_threads);
+
+  for (size_t n = 1024; n <= 8192; n *= 2) {
+    Matrix2D<float> a{n, n};
+    Matrix2D<float> b{n, n};
+    std::mt19937 gen{42};
+    for (size_t i = 0; i < n; i++) {
+      for (size_t j = 0; j < n; j++) {
+        a[i, j] = (float)(int)(gen() % 17) - 8;
+        b[i, j] = (float)(int)(gen() % 17) - 8;
+      }
+    }
+    const double flops = 2.0 * n * n * n;
+
+    Matrix2D<float> expected;
+    auto time = timer_wrap([&]() { expected = multiply(a, b); })();
+    const double serial = std::chrono::duration<double>(time).count();
+    std::cout << std::format("[{:>4}] multiply          {:7.2f} GFLOP/s\n", n,
+                             flops / serial / 1e9)
+              << std::flush;
+
+    for (size_t threads : thread_counts) {
+      handle_runner pool{16, threads};
+      Matrix2D<float> c;
+      Matrix2D<float> sum;
+      double elementwise = 0;
+      time = timer_wrap([&]() {
+        [&]() -> async::co_task {
+          c = co_await async::parallel_multiply(a, b, pool);
+          const auto start = std::chrono::steady_clock::now();
+          sum = co_await async::parallel_add(c, expected, pool);
+          elementwise = std::chrono::duration<double>(std::chrono::steady_clock::now() - start)
+                            .count();
+        }()
+                    .get_future()
+                    .get();
+      })();
+      const double seconds = std::chrono::duration<double>(time).count() - elementwise;
+      bool same = true;
+      for (size_t i = 0; i < n && same; i++) {
+        same = std::ranges::equal(c.row(i), expected.row(i));
+      }
+      std::cout << std::format("[{:>4}] {:>2} threads: multiply {:7.2f} GFLOP/s (x{:.2f}){}, "
+                               "add {:6.2f} G elem/s\n",
+                               n, threads, flops / seconds / 1e9, serial / seconds,
+                               same ? "" : " MISMATCH", (double)n * n / elementwise / 1e9)
+                << std::flush;
+    }
+  }
+}
+
+void try_matrix_transpose() {
+  const auto level = detect_simd_level();
+  std::cout << std::format("simd level: {}\n", (int)level);
+  for (size_t n = 256; n <= 16384; n *= 2) {
+    Matrix2D<float> src{n, n};
+    for (size_t i = 0; i < n; i++) {
+      for (size_t j = 0; j < n; j++) {
+        src[i, j] = (float)(i * n + j);
+      }
+    }
+    Matrix2D<float> dst{n, n};
+    // 每种方法至少重复到约 0.2 秒, 读写各算一次
+    const double bytes = 2.0 * (double)n * n * sizeof(float);
+    const int reps = (int)std::clamp(0.2 * 4e9 / bytes, 1.0, 1000.0);
+    auto bench = [&](auto f) {
+      auto time = timer_wrap([&]() {
+        for (int i = 0; i < reps; i++) {
+          f();
+        }
+      })();
+      return bytes * reps / std::chrono::duration<double>(time).count() / 1e9;
+    };
+    auto check = [&](const Matrix2D<float>& t) {
+      for (size_t i = 0; i < n; i++) {
+        if (!std::ranges::equal(src.col(i), t.row(i))) {
+          return " MISMATCH";
+        }
+      }
+      return "";
+    };
+
+    const double naive = bench([&]() {
+      for (size_t i = 0; i < n; i++) {
+        for (size_t j = 0; j < n; j++) {
+          dst[j, i] = src[i, j];
+        }
+      }
+    });
+    std::cout << std::format("[{:>5}] naive {:6.2f} GB/s{}", n, naive, check(dst));
+    const double scalar = bench([&]() {
+      transpose_detail::transpose_recursive<float>(src.data(), src.stride(), dst.data(),
+                                                   dst.stride(), n, n, nullptr);
+    });
+    std::cout << std::format(", recursive scalar {:6.2f} GB/s{}", scalar, check(dst));
+    const double portable = bench([&]() {
+      transpose_detail::transpose_recursive<float>(src.data(), src.stride(), dst.data(),
+                                                   dst.stride(), n, n,
+                                                   transpose_kernels_for<float>(simd_level::portable));
+    });
+    std::cout << std::format(", portable {:6.2f} GB/s{}", portable, check(dst));
+    const double simd = bench([&]() { transpose(src.view(), dst.view()); });
+    std::cout << std::format(", transpose {:6.2f} GB/s (x{:.1f}){}", simd, simd / naive,
+                             check(dst));
+    dst = src;
+    const double in_place = bench([&]() { transpose_in_place(dst); });
+    if (reps % 2 == 0) {
+      transpose_in_place(dst);
+    }
+    std::cout << std::format(", in place {:6.2f} GB/s{}\n", in_place, check(dst)) << std::flush;
+  }
+}
+
+namespace {
+
+/**
+ * @brief 独占的临时目录: 构造时清空并创建, 析构时 (包括异常退出) 连同其中的文件一起删除
+ */
+struct temp_directory {
+  std::filesystem::path path;
+
+  explicit temp_directory(std::filesystem::path p) : path{std::move(p)} {
+    std::filesystem::remove_all(path);
+    std::filesystem::create_directories(path);
+  }
+
+  temp_directory(const temp_directory&) = delete;
+  temp_directory& operator=(const temp_directory&) = delete;
+
+  ~temp_directory() {
+    std::error_code ec;
+    std::filesystem::remove_all(path, ec);
+  }
+};
+
+}  // namespace
+
+/**
+ * @brief 矩阵文件: 文本与二进制的读写对比; 设置环境变量 PLAYGROUND_MATRIX_FILE_DIR 为一个
+ * 剩余空间大于物理内存的目录时, 再在其中写出比物理内存大的文件并按分块遍历
+ */
+void try_matrix_file() {
+  const temp_directory tmp{std::filesystem::temp_directory_path() / "playground_matrix_file"};
+  const auto& dir = tmp.path;
+  auto ms = [](auto d) { return std::chrono::duration<double, std::milli>(d).count(); };
+  auto gb_per_s = [](double bytes, auto d) {
+    return bytes / std::chrono::duration<double>(d).count() / 1e9;
+  };
+
+  // 文本 operator<< 与二进制文件
+  const size_t n = 2048;
+  Matrix2D<float> m{n, n};
+  for (size_t i = 0; i < n; i++) {
+    for (size_t j = 0; j < n; j++) {
+      m[i, j] = (float)(i * n + j) / 7.0f;
+    }
+  }
+  const double bytes = (double)n * n * sizeof(float);
+  auto time = timer_wrap([&]() {
+    std::ofstream out{dir / "m.txt"};
+    out << m;
+  })();
+  std::cout << std::format("[{}x{}] text operator<<: {:8.2f} ms, {} MB\n", n, n, ms(time),
+                           std::filesystem::file_size(dir / "m.txt") >> 20);
+  time = timer_wrap([&]() { save_matrix(dir / "m.bin", m); })();
+  std::cout << std::format("[{}x{}] save_matrix:     {:8.2f} ms, {} MB, {:.2f} GB/s\n", n, n,
+                           ms(time), std::filesystem::file_size(dir / "m.bin") >> 20,
+                           gb_per_s(bytes, time));
+  Matrix2D<float> loaded;
+  time = timer_wrap([&]() { loaded = load_matrix<float>(dir / "m.bin"); })();
+  bool same = true;
+  for (size_t i = 0; i < n && same; i++) {
+    same = std::ranges::equal(loaded.row(i), m.row(i));
+  }
+  std::cout << std::format("[{}x{}] load_matrix:     {:8.2f} ms, {:.2f} GB/s{}\n", n, n, ms(time),
+                           gb_per_s(bytes, time), same ? "" : " MISMATCH");
+  time = timer_wrap([&]() { mapped_matrix<float> mapped{dir / "m.bin"}; })();
+  std::cout << std::format("[{}x{}] mapped_matrix:   {:8.3f} ms\n", n, n, ms(time));
+
+  // 核外遍历: 逐行写出比物理内存大的文件 (以 16GB 为上限), 再按分块求每列的和
+  const char* target = std::getenv("PLAYGROUND_MATRIX_FILE_DIR");
+  if (target == nullptr) {
+    std::cout << "[out-of-core] skipped, set PLAYGROUND_MATRIX_FILE_DIR to enable\n" << std::flush;
+    return;
+  }
+  const size_t page = (size_t)::sysconf(_SC_PAGESIZE);
+  const size_t physical = (size_t)::sysconf(_SC_PHYS_PAGES) * page;
+  const size_t cols = 8192;
+  const size_t rows = std::min(physical, (size_t)16 << 30) / (cols * sizeof(float)) + 4096;
+  const size_t required = rows * Matrix2D<float>::padded_stride(cols) * sizeof(float);
+  if (const auto space = std::filesystem::space(target); space.available < required) {
+    std::cout << std::format("[out-of-core] skipped, {} has {:.1f} GB free, needs {:.1f} GB\n",
+                             target, (double)space.available / 1e9, (double)required / 1e9)
+              << std::flush;
+    return;
+  }
+  const temp_directory big_dir{std::filesystem::path{target} / "playground_matrix_file"};
+  auto resident = [&]() {
+    size_t total = 0;
+    size_t rss = 0;
+    std::ifstream{"/proc/self/statm"} >> total >> rss;
+    return rss * page;
+  };
+  std::vector<double> expected(cols);
+  time = timer_wrap([&]() {
+    matrix_file_writer<float> writer{big_dir.path / "big.bin", cols};
+    std::vector<float> row(cols);
+    for (size_t r = 0; r < rows; r++) {
+      for (size_t c = 0; c < cols; c++) {
+        row[c] = (float)((r * 31 + c) % 1024);
+        expected[c] += row[c];
+      }
+      writer.append_row(row);
+    }
+    writer.finish();
+  })();
+  const double file_bytes = (double)std::filesystem::file_size(big_dir.path / "big.bin");
+  std::cout << std::format("[out-of-core] {}x{} ({:.1f} GB, physical memory {:.1f} GB): "
+                           "write {:.2f} GB/s\n",
+                           rows, cols, file_bytes / 1e9, (double)physical / 1e9,
+                           gb_per_s(file_bytes, time))
+            << std::flush;
+
+  std::vector<double> sums(cols);
+  const size_t baseline = resident();
+  size_t peak = baseline;
+  time = timer_wrap([&]() {
+    const mapped_matrix<float> big{big_dir.path / "big.bin"};
+    big.for_each_tile(1024, 2048, [&](size_t, size_t c, matrix_view<const float> tile) {
+      for (size_t i = 0; i < tile.rows(); i++) {
+        const auto row = tile.row(i);
+        for (size_t j = 0; j < row.size(); j++) {
+          sums[c + j] += row[j];
+        }
+      }
+      peak = std::max(peak, resident());
+    });
+  })();
+  std::cout << std::format("[out-of-core] tile walk: {:.2f} GB/s, resident +{} MB{}\n",
+                           gb_per_s(file_bytes, time), (peak - baseline) >> 20,
+                           sums == expected ? "" : " MISMATCH");
+}
+
+void try_sparse_matrix() {
+  using triplets = std::vector<triplet<double>>;
+  const size_t hardware_threads = std::max(1u, std::thread::hardware_concurrency());
+  std::mt19937_64 gen{42};
+  auto random_value = [&]() { return (double)(int)(gen() % 17) - 8; };
+  // 每行 per_row 个随机列, 含少量重复的 (row, col)
+  auto make_random = [&](size_t n, size_t per_row) {
+    triplets t;
+    t.reserve(n * per_row);
+    for (size_t r = 0; r < n; r++) {
+      for (size_t k = 0; k < per_row; k++) {
+        t.push_back({r, gen() % n, random_value()});
+      }
+    }
+    return t;
+  };
+  // 主对角线两侧各 half_band 条对角线
+  auto make_banded = [&](size_t n, size_t half_band) {
+    triplets t;
+    t.reserve(n * (2 * half_band + 1));
+    for (size_t r = 0; r < n; r++) {
+      for (size_t c = r - std::min(r, half_band); c <= std::min(n - 1, r + half_band); c++) {
+        t.push_back({r, c, random_value()});
+      }
+    }
+    return t;
+  };
+
+  auto bench = [&](std::string_view tag, size_t n, triplets t) {
+    std::ranges::shuffle(t, gen);
+    csr_matrix<double> a;
+    for (size_t threads = 1;; threads = hardware_threads) {
+      auto time = timer_wrap([&]() { a = csr_matrix<double>::from_triplets(n, n, t, threads); })();
+      std::cout << std::format("[{}] from {} triplets, {:>2} threads: {:8.2f} ms\n", tag, t.size(),
+                               threads, std::chrono::duration<double, std::milli>(time).count())
+                << std::flush;
+      if (threads == hardware_threads) {
+        break;
+      }
+    }
+    csc_matrix<double> b;
+    auto time = timer_wrap([&]() { b = a.to_csc(); })();
+    std::cout << std::format("[{}] nnz {}, csr -> csc: {:8.2f} ms\n", tag, a.nnz(),
+                             std::chrono::duration<double, std::milli>(time).count());
+
+    std::vector<double> x(n);
+    std::ranges::generate(x, random_value);
+    std::vector<double> expected(n);
+    std::vector<double> y(n);
+    const int reps = 10;
+    auto report = [&](std::string_view what, auto f) {
+      auto time = timer_wrap([&]() {
+        for (int i = 0; i < reps; i++) {
+          f();
+        }
+      })();
+      const double seconds = std::chrono::duration<double>(time).count() / reps;
+      std::cout << std::format("[{}] {:<22} {:7.2f} GFLOP/s{}\n", tag, what,
+                               2.0 * (double)a.nnz() / seconds / 1e9,
+                               y == expected ? "" : " MISMATCH")
+                << std::flush;
+    };
+    multiply(a, x, expected);
+    report("spmv csr", [&]() { multiply(a, x, y); });
+    report("spmv csc", [&]() { multiply(b, x, y); });
+    handle_runner pool{16, hardware_threads};
+    report(std::format("spmv csr {} threads", hardware_threads), [&]() {
+      [&]() -> async::co_task {
+        co_await async::parallel_multiply(a, x, y, pool);
+      }()
+                   .get_future()
+                   .get();
+    });
+
+    // SpMM: 与 16 列的稠密矩阵相乘
+    const size_t k = 16;
+    Matrix2D<double> dense{n, k};
+    for (size_t i = 0; i < n; i++) {
+      std::ranges::generate(dense.row(i), random_value);
+    }
+    Matrix2D<double> c;
+    time = timer_wrap([&]() { c = multiply(a, dense); })();
+    const double csr_seconds = std::chrono::duration<double>(time).count();
+    time = timer_wrap([&]() { c = multiply(b, dense); })();
+    const double csc_seconds = std::chrono::duration<double>(time).count();
+    const double flops = 2.0 * (double)a.nnz() * k;
+    std::cout << std::format("[{}] spmm x{} csr {:7.2f} GFLOP/s, csc {:7.2f} GFLOP/s\n", tag, k,
+                             flops / csr_seconds / 1e9, flops / csc_seconds / 1e9)
+              << std::flush;
+  };
+
+  bench("random", (size_t)1 << 20, make_random((size_t)1 << 20, 8));
+  bench("banded", (size_t)1 << 21, make_banded((size_t)1 << 21, 2));
+
+  // 与稠密矩阵互相转换 (重复元素相加为 0 时 from dense 会丢掉它们, 因此用 SpMV 的结果比较)
+  const size_t n = 4096;
+  auto sparse = csr_matrix<double>::from_triplets(n, n, make_random(n, n / 100));
+  Matrix2D<double> dense;
+  auto time = timer_wrap([&]() { dense = sparse.to_dense(); })();
+  std::cout << std::format("[dense] {}x{} with {} nnz, to_dense: {:6.2f} ms", n, n, sparse.nnz(),
+                           std::chrono::duration<double, std::milli>(time).count());
+  csr_matrix<double> back;
+  time = timer_wrap([&]() { back = csr_matrix<double>{dense.view()}; })();
+  std::cout << std::format(", from dense: {:6.2f} ms{}\n",
+                           std::chrono::duration<double, std::milli>(time).count(),
+                           multiply(back, dense.row(0)) == multiply(sparse, dense.row(0))
+                               ? ""
+                               : " MISMATCH");
 }
 
 void try_shared_mutex() {
@@ -297,142 +1008,1188 @@ class arr_msg {
 
 }  // namespace
 
-void try_message() {
-  using msg_v_t = std::variant<std::monostate, double, int, std::string, char, arr_msg,
-                               std::pair<double, double>>;
-  using msg_t = msg::message<msg_v_t>;
-  std::vector<msg_t> messages;
-  messages.reserve(7);
+void try_message() {
+  using msg_v_t = std::variant<std::monostate, double, int, std::string, char, arr_msg,
+                               std::pair<double, double>>;
+  using msg_t = msg::message<msg_v_t>;
+  std::vector<msg_t> messages;
+  messages.reserve(7);
+
+  messages.emplace_back(3.14, 1);
+  messages.emplace_back(12345, 2);
+  messages.emplace_back("Hello, world!", 3);
+  messages.emplace_back('c', 4);
+  auto arr_ptr = std::make_shared<std::vector<int>>(std::initializer_list{-1, 0, 1});
+  messages.emplace_back(arr_msg{std::move(arr_ptr)}, 5);
+  messages.emplace_back(std::make_pair(2.71828, 3.14159), 6);
+  messages.emplace_back(msg_t{.serial_number = 7});
+
+  auto inplace_modify = temp_visitor{[](auto& data) { /* fallback, do nothing */ },
+                                     [](std::string& data) { data += "[suffix]"; },
+                                     [](arr_msg& data) {
+                                       auto& arr = data.data();
+                                       const auto size = arr.size();
+                                       // append #size numbers
+                                       for (size_t i = 0; i < size; i++) {
+                                         arr.emplace_back(1 + *arr.rbegin());
+                                       }
+                                     }};
+
+  auto output = temp_visitor{[](const auto& data) { /* fallback, do nothing */ },
+                             [](double data) { std::cout << data << std::endl; },
+                             [](int data) { std::cout << data << std::endl; },
+                             [](const std::string& data) { std::cout << data << std::endl; },
+                             [](char data) { std::cout << data << std::endl; },
+                             [](const arr_msg& data) {
+                               const auto& arr = data.data();
+                               for (const auto& item : arr) {
+                                 std::cout << item << " ";
+                               }
+                               std::cout << std::endl;
+                             },
+                             [](const std::pair<double, double>& data) {
+                               std::cout << std::format("({}, {})", data.first, data.second)
+                                         << std::endl;
+                             }};
+
+  std::ranges::sort(messages, std::greater<msg_t>{});  // sort by serial number in descending order
+  // here filter is unnecessary, since visitor has fallback branch. only to show the usage of
+  // msg_t::data_t_in<>();
+  std::ranges::for_each(messages | std::views::filter([](const msg_t& m) {
+                          return m.data_t_in<std::string, arr_msg>();
+                        }),
+                        [&](msg_t& m) { std::visit(std::move(inplace_modify), m.data); });
+  std::ranges::for_each(messages, [&](const msg_t& m) { std::visit(std::move(output), m.data); });
+}
+
+namespace {
+
+struct counter_controller {
+  std::atomic<int> count{0};
+  std::function<void()> callback;
+  operator int() const noexcept {
+    return count;
+  }
+  counter_controller& operator++() noexcept {
+    ++count;
+    return *this;
+  }
+  counter_controller& operator--() {
+    if (--count == 0) {
+      callback();
+    }
+    return *this;
+  }
+  struct guard {
+    counter_controller& ctrl;
+    guard(counter_controller& ctrl) noexcept : ctrl{ctrl} {
+      ++ctrl;
+    }
+    ~guard() {
+      --ctrl;
+    }
+  };
+};
+
+struct sum_msg {
+  size_t value;
+};
+
+struct square_sum_msg {
+  size_t value;
+};
+
+}  // namespace
+
+void try_msg_stream() {
+  const auto N = 100'000'000LL;
+  const size_t mod = 998244353;
+  std::vector data{std::from_range, std::views::iota(1LL, N + 1LL)};
+
+  using msg_t = msg::message<std::variant<std::monostate, sum_msg, square_sum_msg>>;
+  sync_stream<msg_t> stream;
+  counter_controller counter{.callback = [&]() { stream.stop(); }};
+
+  guarded_thread task1{std::thread{[&]() {
+    counter_controller::guard guard{counter};
+    for (int i = 0; i < 5; i++) {
+      stream.write_sync(sum_msg{std::ranges::fold_left(data, (size_t)0, std::plus<size_t>{})});
+    }
+  }}};
+
+  guarded_thread task2{std::thread{[&]() {
+    counter_controller::guard guard{counter};
+    for (int i = 0; i < 5; i++) {
+      stream.write_sync(
+          square_sum_msg{std::ranges::fold_left(data, (size_t)0, [](size_t s, size_t v) {
+            auto res = s + (v * v % mod);
+            res = res >= mod ? res - mod : res;
+            res = res < 0 ? res + mod : res;
+            return res;
+          })});
+    }
+  }}};
+
+  auto output =
+      msg::router<msg_t::variant_t>{}
+          .on<sum_msg>(
+              [](const sum_msg& data) { std::cout << "sum = " << data.value << std::endl; })
+          .on<square_sum_msg>([](const square_sum_msg& data) {
+            std::cout << "moded square sum = " << data.value << std::endl;
+          });
+  guarded_thread output_task{std::thread{[&]() {
+    while (stream) {
+      msg_t msg;
+      if (stream.read_sync(msg) == sync_stream<msg_t>::status::good) {
+        output(msg);
+      }
+    }
+  }}};
+}
+
+/**
+ * @brief try_msg_stream 的吞吐版本: 两个写入线程各写 M 条消息, 一个读取线程统计,
+ * 对比 sync_stream (mutex + condition_variable) 与 lockfree_sync_stream (fix_cap_queue + eventcount).
+ */
+void try_msg_stream2() {
+  const size_t M = 1'000'000;
+  using msg_t = msg::message<std::variant<std::monostate, sum_msg, square_sum_msg>>;
+
+  auto bench = [&]<typename stream_t>(std::string tag, stream_t& stream) {
+    counter_controller counter{.callback = [&]() { stream.stop(); }};
+    size_t sum = 0;
+    size_t square_sum = 0;
+    auto time = timer_wrap([&]() {
+      guarded_thread task1{std::thread{[&]() {
+        counter_controller::guard guard{counter};
+        for (size_t i = 0; i < M; i++) {
+          stream.write_sync(sum_msg{i});
+        }
+      }}};
+      guarded_thread task2{std::thread{[&]() {
+        counter_controller::guard guard{counter};
+        for (size_t i = 0; i < M; i++) {
+          stream.write_sync(square_sum_msg{i});
+        }
+      }}};
+      guarded_thread output_task{std::thread{[&]() {
+        auto visitor = temp_visitor{[](const auto& data) {},
+                                    [&](const sum_msg& data) { sum += data.value; },
+                                    [&](const square_sum_msg& data) { square_sum += data.value; }};
+        while (stream) {
+          msg_t msg;
+          if (stream.read_sync(msg) == stream_t::status::good) {
+            std::visit(visitor, msg.data);
+          }
+        }
+      }}};
+    })();
+    std::cout << std::format("{} {} messages, sum = {}, square_sum = {}, cost time: {}\n", tag,
+                             2 * M, sum, square_sum,
+                             std::chrono::duration_cast<std::chrono::milliseconds>(time))
+              << std::flush;
+  };
+
+  for (int i = 0; i < 3; i++) {
+    sync_stream<msg_t> stream;
+    bench("[sync_stream]", stream);
+    lockfree_sync_stream<msg_t> lockfree_stream{16};
+    bench("[lockfree_sync_stream]", lockfree_stream);
+  }
+}
+
+/**
+ * @brief sync_stream 逐条读写与批量读写 (write_many / read_many / drain) 的吞吐对比
+ */
+void try_msg_stream3() {
+  const size_t M = 1'000'000;
+  const size_t batch_size = 256;
+  using msg_t = msg::message<std::variant<std::monostate, sum_msg, square_sum_msg>>;
+  using stream_t = sync_stream<msg_t>;
+
+  auto bench = [&](std::string tag, auto write, auto read) {
+    stream_t stream;
+    counter_controller counter{.callback = [&]() { stream.stop(); }};
+    size_t sum = 0;
+    size_t square_sum = 0;
+    auto visitor = temp_visitor{[](const auto& data) {},
+                                [&](const sum_msg& data) { sum += data.value; },
+                                [&](const square_sum_msg& data) { square_sum += data.value; }};
+    auto time = timer_wrap([&]() {
+      guarded_thread task1{std::thread{[&]() {
+        counter_controller::guard guard{counter};
+        write(stream, [](size_t i) { return sum_msg{i}; });
+      }}};
+      guarded_thread task2{std::thread{[&]() {
+        counter_controller::guard guard{counter};
+        write(stream, [](size_t i) { return square_sum_msg{i}; });
+      }}};
+      guarded_thread output_task{std::thread{[&]() {
+        while (stream) {
+          read(stream, [&](msg_t&& msg) { std::visit(visitor, msg.data); });
+        }
+      }}};
+    })();
+    std::cout << std::format("{} {} messages, sum = {}, square_sum = {}, cost time: {}\n", tag,
+                             2 * M, sum, square_sum,
+                             std::chrono::duration_cast<std::chrono::milliseconds>(time))
+              << std::flush;
+  };
+
+  auto write_one = [&](stream_t& stream, auto make) {
+    for (size_t i = 0; i < M; i++) {
+      stream.write_sync(make(i));
+    }
+  };
+  auto write_batch = [&](stream_t& stream, auto make) {
+    for (size_t i = 0; i < M; i += batch_size) {
+      stream.write_many(std::views::iota(i, std::min(i + batch_size, M)) |
+                        std::views::transform(make));
+    }
+  };
+  auto read_one = [](stream_t& stream, auto callback) {
+    msg_t msg;
+    if (stream.read_sync(msg) == stream_t::status::good) {
+      callback(std::move(msg));
+    }
+  };
+  auto read_batch = [buffer = std::vector<msg_t>{}](stream_t& stream, auto callback) mutable {
+    buffer.clear();
+    stream.read_many(std::back_inserter(buffer), batch_size);
+    for (auto& msg : buffer) {
+      callback(std::move(msg));
+    }
+  };
+  auto read_drain = [](stream_t& stream, auto callback) { stream.drain(callback); };
+
+  for (int i = 0; i < 2; i++) {
+    bench("[write_sync + read_sync]", write_one, read_one);
+    bench("[write_many + read_sync]", write_batch, read_one);
+    bench("[write_many + read_many]", write_batch, read_batch);
+    bench("[write_many + drain]", write_batch, read_drain);
+  }
+}
+
+/**
+ * @brief 时间戳来源对比: 单次调用开销, 以及作为 sync_stream 的 TSGen 时的吞吐 (messages/s)
+ * * default_timestamp_generator 在锁内调用; 其余声明了 thread_safe, 在加锁前调用
+ */
+void try_msg_stream4() {
+  const size_t N = 10'000'000;
+  const size_t M = 500'000;
+  const size_t writers = 4;
+  using msg_t = msg::message<std::variant<std::monostate, sum_msg, square_sum_msg>>;
+
+  auto bench_call = [&]<typename TSGen>(std::string tag, TSGen gen) {
+    gen();  // 校准 / 启动后台线程不计入
+    int64_t checksum = 0;
+    auto time = timer_wrap([&]() {
+      for (size_t i = 0; i < N; i++) {
+        checksum += gen().time_since_epoch().count() & 1;
+      }
+    })();
+    std::cout << std::format("{} {:.1f} ns/call (checksum {})\n", tag,
+                             std::chrono::duration<double, std::nano>(time).count() / N, checksum)
+              << std::flush;
+  };
+
+  auto bench_stream = [&]<typename TSGen>(std::string tag, TSGen) {
+    sync_stream<msg_t, default_id_generator, TSGen> stream;
+    counter_controller counter{.callback = [&]() { stream.stop(); }};
+    size_t count = 0;
+    auto time = timer_wrap([&]() {
+      std::vector<guarded_thread> tasks;
+      for (size_t t = 0; t < writers; t++) {
+        tasks.emplace_back(std::thread{[&]() {
+          counter_controller::guard guard{counter};
+          for (size_t i = 0; i < M; i++) {
+            stream.write_sync(sum_msg{i});
+          }
+        }});
+      }
+      guarded_thread output_task{std::thread{[&]() {
+        while (stream) {
+          count += stream.drain([](msg_t&&) {});
+        }
+      }}};
+    })();
+    const double seconds = std::chrono::duration<double>(time).count();
+    std::cout << std::format("{} {} messages, {:.2f} M messages/s\n", tag, count,
+                             count / seconds / 1e6)
+              << std::flush;
+  };
+
+  bench_call("[system_clock]", default_timestamp_generator{});
+  bench_call("[coarse]", coarse_timestamp_generator{});
+  bench_call("[tsc]", tsc_timestamp_generator{});
+  bench_call("[cached]", cached_timestamp_generator{});
+  for (int i = 0; i < 2; i++) {
+    bench_stream("[sync_stream + system_clock]", default_timestamp_generator{});
+    bench_stream("[sync_stream + coarse]", coarse_timestamp_generator{});
+    bench_stream("[sync_stream + tsc]", tsc_timestamp_generator{});
+    bench_stream("[sync_stream + cached]", cached_timestamp_generator{});
+  }
+}
+
+/**
+ * @brief partitioned_sync_stream: 每种消息一个专属读取线程 (只在自己的分区上等待),
+ * 以及按序列号顺序读取全部消息的合并读取
+ */
+void try_msg_stream5() {
+  const size_t M = 1'000'000;
+  using msg_t = msg::message<std::variant<std::monostate, sum_msg, square_sum_msg>>;
+  using stream_t = partitioned_sync_stream<msg_t>;
+
+  auto writer = [&](stream_t& stream, counter_controller& counter, auto make) {
+    return guarded_thread{std::thread{[&stream, &counter, make]() {
+      counter_controller::guard guard{counter};
+      for (size_t i = 0; i < M; i++) {
+        stream.write_sync(make(i));
+      }
+    }}};
+  };
+  auto make_sum = [](size_t i) { return sum_msg{i}; };
+  auto make_square_sum = [](size_t i) { return square_sum_msg{i}; };
+
+
+  {
+    stream_t stream;
+    counter_controller counter{.callback = [&]() { stream.stop(); }};
+    size_t sum = 0;
+    size_t square_sum = 0;
+    auto time = timer_wrap([&]() {
+      guarded_thread task1 = writer(stream, counter, make_sum);
+      guarded_thread task2 = writer(stream, counter, make_square_sum);
+      guarded_thread sum_reader{std::thread{[&]() {
+        msg_t msg;
+        while (stream.active<sum_msg>()) {
+          if (stream.read_sync<sum_msg>(msg) == stream_t::status::good) {
+            sum += msg.get<sum_msg>().value;
+          }
+        }
+      }}};
+      guarded_thread square_sum_reader{std::thread{[&]() {
+        msg_t msg;
+        while (stream.active<square_sum_msg>()) {
+          if (stream.read_sync<square_sum_msg>(msg) == stream_t::status::good) {
+            square_sum += msg.get<square_sum_msg>().value;
+          }
+        }
+      }}};
+    })();
+    std::cout << std::format("[per-type readers] sum = {}, square_sum = {}, cost time: {}\n", sum,
+                             square_sum,
+                             std::chrono::duration_cast<std::chrono::milliseconds>(time))
+              << std::flush;
+  }
+
+  {
+    stream_t stream;
+    counter_controller counter{.callback = [&]() { stream.stop(); }};
+    size_t count = 0;
+    size_t out_of_order = 0;
+    auto time = timer_wrap([&]() {
+      guarded_thread task1 = writer(stream, counter, make_sum);
+      guarded_thread task2 = writer(stream, counter, make_square_sum);
+      guarded_thread reader{std::thread{[&]() {
+        msg_t msg;
+        size_t last = 0;
+        while (stream) {
+          if (stream.read_sync(msg) == stream_t::status::good) {
+            out_of_order += msg.serial_number <= last ? 1 : 0;
+            last = msg.serial_number;
+            count++;
+          }
+        }
+      }}};
+    })();
+    std::cout << std::format("[merged reader] {} messages, out of order: {}, cost time: {}\n",
+                             count, out_of_order,
+                             std::chrono::duration_cast<std::chrono::milliseconds>(time))
+              << std::flush;
+  }
+}
+
+/**
+ * @brief persistent_stream: 写入吞吐 (不同 fdatasync 批大小), 重新打开的恢复耗时,
+ * 以及零拷贝 replay / 解码 replay / read_sync 游标的读取吞吐
+ */
+void try_msg_stream6() {
+  const size_t M = 500'000;
+  using msg_t = msg::message<std::variant<std::monostate, sum_msg, square_sum_msg>>;
+  using stream_t = persistent_stream<msg_t, coarse_timestamp_generator>;
+  const auto root = std::filesystem::temp_directory_path() / "playground_persistent_stream";
+  auto per_second = [](size_t count, auto time) {
+    return count / std::chrono::duration<double>(time).count() / 1e6;
+  };
+
+  for (size_t sync_every : {64, 1024, 0}) {
+    const auto dir = root / std::format("sync_every_{}", sync_every);
+    std::filesystem::remove_all(dir);
+    stream_t stream{{.dir = dir, .segment_bytes = (size_t)16 << 20, .sync_every = sync_every}};
+    auto time = timer_wrap([&]() {
+      guarded_thread task1{std::thread{[&]() {
+        for (size_t i = 0; i < M; i++) {
+          stream.write_sync(sum_msg{i});
+        }
+      }}};
+      guarded_thread task2{std::thread{[&]() {
+        for (size_t i = 0; i < M; i++) {
+          stream.write_sync(square_sum_msg{i});
+        }
+      }}};
+    })();
+    std::cout << std::format("[write, sync_every = {}] {} messages in {} segments, {:.2f} M/s\n",
+                             sync_every, 2 * M, stream.segment_count(), per_second(2 * M, time))
+              << std::flush;
+  }
+
+  const auto dir = root / "sync_every_1024";
+  std::optional<stream_t> stream;
+  auto time = timer_wrap([&]() { stream.emplace(persistent_stream_options{.dir = dir}); })();
+  std::cout << std::format("[reopen] serial [{}, {}), recovered in {}\n", stream->first_serial(),
+                           stream->end_serial(),
+                           std::chrono::duration_cast<std::chrono::milliseconds>(time))
+            << std::flush;
+
+  for (uint64_t from : {(uint64_t)1, (uint64_t)M}) {
+    size_t sum = 0;
+    size_t count = 0;
+    time = timer_wrap([&]() {
+      count = stream->replay(from, [&](const stream_t::record_view& record) {
+        if (record.holds<sum_msg>()) {
+          sum += record.get<sum_msg>().value;
+        }
+      });
+    })();
+    std::cout << std::format("[replay view from {}] {} records, sum = {}, {:.2f} M/s\n", from,
+                             count, sum, per_second(count, time))
+              << std::flush;
+  }
+
+  size_t square_sum = 0;
+  size_t count = 0;
+  time = timer_wrap([&]() {
+    count = stream->replay(1, [&](const stream_t::record_view& record) {
+      msg_t msg = record.decode();
+      if (msg.data_t_same_as<square_sum_msg>()) {
+        square_sum += msg.get<square_sum_msg>().value;
+      }
+    });
+  })();
+  std::cout << std::format("[replay decode] {} records, square_sum = {}, {:.2f} M/s\n", count,
+                           square_sum, per_second(count, time))
+            << std::flush;
+
+  stream->seek(M);
+  stream->stop();
+  count = 0;
+  time = timer_wrap([&]() {
+    msg_t msg;
+    while (*stream) {
+      count += stream->read_sync(msg) == stream_t::status::good ? 1 : 0;
+    }
+  })();
+  std::cout << std::format("[read_sync from {}] {} messages, {:.2f} M/s\n", M, count,
+                           per_second(count, time))
+            << std::flush;
+  stream.reset();
+  std::filesystem::remove_all(root);
+}
+
+/**
+ * @brief 一条消息投递给多个消费者: 每个消费者一个 sync_stream (逐个拷贝消息, shared_ptr 计数
+ * 逐个 +1 / -1) 与 pubsub_hub (一个信封, 每个订阅者一次指针写入, 批量读取) 的对比;
+ * 以及按类型过滤、有界滞后 (drop) 的订阅者
+ */
+void try_msg_stream7() {
+  const size_t N = 200'000;
+  const size_t consumers = 4;
+  using msg_t = msg::message<std::variant<std::monostate, sum_msg, arr_msg>>;
+  auto payload = std::make_shared<std::vector<int>>(256, 1);
+  auto report = [&](std::string tag, size_t total, auto time) {
+    std::cout << std::format("{} {} deliveries, {:.2f} M deliveries/s\n", tag, total,
+                             total / std::chrono::duration<double>(time).count() / 1e6)
+              << std::flush;
+  };
+
+  for (int round = 0; round < 2; round++) {
+    std::vector<sync_stream<msg_t>> streams(consumers);
+    std::atomic<size_t> total{0};
+    auto time = timer_wrap([&]() {
+      std::vector<guarded_thread> readers;
+      for (auto& stream : streams) {
+        readers.emplace_back(std::thread{[&]() {
+          size_t count = 0;
+          while (stream) {
+            count += stream.drain([](msg_t&& msg) { (void)msg.get<arr_msg>().data().size(); });
+          }
+          total += count;
+        }});
+      }
+      for (size_t i = 0; i < N; i++) {
+        msg_t msg{arr_msg{payload}};
+        for (auto& stream : streams) {
+          stream.write_sync(msg);
+        }
+      }
+      for (auto& stream : streams) {
+        stream.stop();
+      }
+    })();
+    report("[sync_stream x 4]", total.load(), time);
+  }
+
+  for (int round = 0; round < 2; round++) {
+    pubsub_hub<msg_t> hub;
+    std::atomic<size_t> total{0};
+    auto time = timer_wrap([&]() {
+      std::vector<guarded_thread> readers;
+      for (size_t i = 0; i < consumers; i++) {
+        readers.emplace_back(std::thread{[&, sub = hub.subscribe(1024)]() mutable {
+          std::vector<pubsub_hub<msg_t>::ptr_t> batch;
+          size_t count = 0;
+          while (sub) {
+            batch.clear();
+            count += sub.read_many(std::back_inserter(batch), 64);
+            for (const auto& msg : batch) {
+              (void)msg->get<arr_msg>().data().size();
+            }
+          }
+          total += count;
+        }});
+      }
+      for (size_t i = 0; i < N; i++) {
+        hub.publish(arr_msg{payload});
+      }
+      hub.stop();
+    })();
+    report("[pubsub_hub x 4]", total.load(), time);
+  }
+
+  {
+    pubsub_hub<msg_t> hub;
+    auto all = hub.subscribe(N);
+    auto sums_only = hub.subscribe<sum_msg>(16, overflow_policy::drop);
+    for (size_t i = 0; i < 1000; i++) {
+      hub.publish_many(std::views::iota(i * 10, i * 10 + 10) |
+                       std::views::transform([](size_t i) { return sum_msg{i}; }));
+      hub.publish(arr_msg{payload});
+    }
+    hub.stop();
+    size_t sum = 0;
+    pubsub_hub<msg_t>::ptr_t msg;
+    while (sums_only.read_sync(msg) == pubsub_hub<msg_t>::status::good) {
+      sum += msg->get<sum_msg>().value;
+    }
+    std::cout << std::format("[filter + drop] all: lag {}; sums_only: read sum {}, dropped {}\n",
+                             all.lag(), sum, sums_only.dropped())
+              << std::flush;
+  }
+
+  {
+    // block 下订阅者不再读取: 发布方阻塞在 reserve 中 (持有发布锁), stop 仍能唤醒它并返回
+    pubsub_hub<msg_t> hub;
+    auto stalled = hub.subscribe<sum_msg>(16, overflow_policy::block);
+    std::atomic<size_t> published{0};
+    guarded_thread publisher{std::thread{[&]() {
+      for (size_t i = 0; i < 1000; i++) {
+        hub.publish(sum_msg{i});
+        published++;
+      }
+    }}};
+    while (stalled.lag() < 16) {
+      std::this_thread::yield();
+    }
+    auto time = timer_wrap([&]() {
+      hub.stop();
+      publisher->join();
+    })();
+    std::cout << std::format("[block + stop] stalled: lag {}, dropped {}; published {}, "
+                             "stop + join {}\n",
+                             stalled.lag(), stalled.dropped(), published.load(),
+                             std::chrono::duration_cast<std::chrono::microseconds>(time))
+              << std::flush;
+  }
+}
+
+/**
+ * @brief stream_merger: N 个写入线程各写一个 sync_stream, 一个读取方按时间戳合并输出;
+ * 统计吞吐、输出中的逆序数与迟到消息数
+ */
+void try_msg_stream8() {
+  const size_t M = 1'000'000;
+  using msg_t = msg::message<std::variant<std::monostate, sum_msg, square_sum_msg>>;
+  using stream_t = sync_stream<msg_t>;
+  using namespace std::chrono_literals;
+
+  for (size_t n : {1, 2, 4, 8, 16}) {
+    std::vector<stream_t> streams(n);
+    std::vector<stream_t*> pointers;
+    for (auto& stream : streams) {
+      pointers.push_back(&stream);
+    }
+    stream_merger<stream_t> merger{pointers, {.allowed_lateness = 1ms, .batch = 256}};
+    size_t count = 0;
+    size_t inversions = 0;
+    size_t sum = 0;
+    auto time = timer_wrap([&]() {
+      std::vector<guarded_thread> writers;
+      for (auto& stream : streams) {
+        writers.emplace_back(std::thread{[&stream, n]() {
+          for (size_t i = 0; i < M / n; i++) {
+            stream.write_sync(sum_msg{i});
+          }
+          stream.stop();
+        }});
+      }
+      std::vector<msg_t> batch;
+      std::optional<msg_t::timestamp_t> last;
+      while (merger) {
+        batch.clear();
+        merger.read_many(std::back_inserter(batch), 256);
+        for (auto& msg : batch) {
+          inversions += last && *msg.timestamp < *last ? 1 : 0;
+          last = msg.timestamp;
+          sum += msg.get<sum_msg>().value;
+          count++;
+        }
+      }
+    })();
+    std::cout << std::format(
+                     "[merge {:>2} streams] {} messages, sum = {}, inversions = {}, late = {}, "
+                     "{:.2f} M/s\n",
+                     n, count, sum, inversions, merger.late(),
+                     count / std::chrono::duration<double>(time).count() / 1e6)
+              << std::flush;
+  }
+}
+
+namespace {
+
+struct quote_msg {
+  uint32_t instrument;
+  double bid;
+  double ask;
+  uint64_t volume;
+};
+
+struct text_msg {
+  uint32_t channel{};
+  std::string text;
+
+  auto codec_fields() {
+    return std::tie(channel, text);
+  }
+
+  auto codec_fields() const {
+    return std::tie(channel, text);
+  }
+};
+
+}  // namespace
+
+/**
+ * @brief message_codec 与手写编解码 (相同格式, switch + memcpy) 的吞吐对比
+ */
+void try_msg_codec() {
+  const size_t N = 1'000'000;
+  using msg_t = msg::message<std::variant<std::monostate, sum_msg, quote_msg, text_msg>>;
+
+  std::vector<msg_t> messages(N);
+  auto now = std::chrono::system_clock::now();
+  for (size_t i = 0; i < N; i++) {
+    messages[i].serial_number = i + 1;
+    messages[i].timestamp = now + std::chrono::microseconds(i);
+    switch (i % 4) {
+      case 0:
+        messages[i].data = text_msg{(uint32_t)i, std::string(i % 32, 'x')};
+        break;
+      case 1:
+        messages[i].data = sum_msg{i};
+        break;
+      default:
+        messages[i].data = quote_msg{(uint32_t)i, 1.0 * i, 1.0 * i + 0.5, i * 100};
+    }
+  }
+  std::vector<std::byte> buffer(N * 64);
+
+  auto hand_encode = [](std::byte* out, const msg_t& msg, int64_t& last) {
+    msg::byte_writer writer{out};
+    const int64_t ticks = msg.timestamp->time_since_epoch().count();
+    const auto head = (uint8_t)(msg.data.index() | 0x80);
+    writer.put(&head, 1);
+    writer.varint(msg.serial_number);
+    writer.varint(msg::zigzag(ticks - last));
+    last = ticks;
+    switch (msg.data.index()) {
+      case 1:
+        writer.put(&msg.get<sum_msg>(), sizeof(sum_msg));
+        break;
+      case 2:
+        writer.put(&msg.get<quote_msg>(), sizeof(quote_msg));
+        break;
+      case 3: {
+        const auto& text = msg.get<text_msg>();
+        writer.put(&text.channel, sizeof(text.channel));
+        writer.varint(text.text.size());
+        writer.put(text.text.data(), text.text.size());
+        break;
+      }
+    }
+    return (size_t)(writer.pos - out);
+  };
+
+  auto hand_decode = [](const std::byte* in, msg_t& msg, int64_t& last) {
+    msg::byte_reader reader{in, in + 64};
+    uint8_t head;
+    uint64_t serial, delta;
+    reader.get(&head, 1);
+    reader.varint(serial);
+    reader.varint(delta);
+    last += msg::unzigzag(delta);
+    msg.serial_number = serial;
+    msg.timestamp = msg_t::timestamp_t{msg_t::timestamp_t::duration{last}};
+    switch (head & 0x7f) {
+      case 1:
+        reader.get(&msg.data.emplace<sum_msg>(), sizeof(sum_msg));
+        break;
+      case 2:
+        reader.get(&msg.data.emplace<quote_msg>(), sizeof(quote_msg));
+        break;
+      case 3: {
+        auto* text = std::get_if<text_msg>(&msg.data);
+        if (!text) {
+          text = &msg.data.emplace<text_msg>();
+        }
+        uint64_t n;
+        reader.get(&text->channel, sizeof(text->channel));
+        reader.varint(n);
+        text->text.resize(n);
+        reader.get(text->text.data(), n);
+        break;
+      }
+    }
+    return (size_t)(reader.pos - in);
+  };
+
+  auto report = [&](std::string tag, size_t bytes, auto time) {
+    std::cout << std::format("{} {:.2f} bytes/msg, {:.2f} M msg/s\n", tag, (double)bytes / N,
+                             N / std::chrono::duration<double>(time).count() / 1e6)
+              << std::flush;
+  };
+
+  for (int round = 0; round < 2; round++) {
+    size_t bytes = 0;
+    size_t checksum = 0;
+    auto encode_time = timer_wrap([&]() {
+      int64_t last = 0;
+      bytes = 0;
+      for (const auto& msg : messages) {
+        bytes += hand_encode(buffer.data() + bytes, msg, last);
+      }
+    })();
+    report("[hand-written encode]", bytes, encode_time);
+    auto decode_time = timer_wrap([&]() {
+      int64_t last = 0;
+      msg_t msg;
+      for (size_t offset = 0; offset < bytes;) {
+        offset += hand_decode(buffer.data() + offset, msg, last);
+        checksum += msg.serial_number;
+      }
+    })();
+    report("[hand-written decode]", bytes, decode_time);
+
+    msg::message_codec<msg_t::variant_t> codec;
+    encode_time = timer_wrap([&]() {
+      bytes = 0;
+      for (const auto& msg : messages) {
+        bytes += *codec.encode_to(std::span{buffer}.subspan(bytes), msg);
+      }
+    })();
+    report("[message_codec encode]", bytes, encode_time);
+    decode_time = timer_wrap([&]() {
+      msg_t msg;
+      for (size_t offset = 0; offset < bytes;) {
+        offset += *codec.decode_from(std::span<const std::byte>{buffer}.subspan(offset), msg);
+        checksum -= msg.serial_number;
+      }
+    })();
+    report("[message_codec decode]", bytes, decode_time);
+    std::cout << std::format("sizeof(msg_t) = {}, checksum = {}\n", sizeof(msg_t), checksum)
+              << std::flush;
+  }
+}
+
+namespace {
+
+/**
+ * @brief 统计向 upstream 申请内存次数的 memory_resource
+ */
+class counting_resource : public std::pmr::memory_resource {
+  std::pmr::memory_resource* upstream;
+  std::atomic<size_t> count{0};
+
+  void* do_allocate(size_t bytes, size_t align) override {
+    count.fetch_add(1, std::memory_order_relaxed);
+    return upstream->allocate(bytes, align);
+  }
+
+  void do_deallocate(void* p, size_t bytes, size_t align) override {
+    upstream->deallocate(p, bytes, align);
+  }
+
+  bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override {
+    return this == &other;
+  }
+
+ public:
+  explicit counting_resource(
+      std::pmr::memory_resource* upstream = std::pmr::new_delete_resource()) noexcept
+      : upstream{upstream} {}
+
+  size_t allocations() const noexcept {
+    return count.load();
+  }
+};
+
+}  // namespace
+
+/**
+ * @brief 小字符串消息的分配次数: 每条消息一次堆分配 vs 按批次的 message_arena + 池化的队列节点
+ */
+void try_msg_arena() {
+  const size_t N = 1'000'000;
+  const size_t batch = 256;
+  const std::string_view text = "a string message longer than the SSO buffer";
+
+  {
+    using msg_t = msg::message<std::variant<std::monostate, std::pmr::string>>;
+    counting_resource payloads;
+    counting_resource nodes;
+    sync_stream<msg_t> stream{&nodes};
+    size_t bytes = 0;
+    auto time = timer_wrap([&]() {
+      guarded_thread reader{std::thread{[&]() {
+        while (stream) {
+          stream.drain([&](msg_t&& msg) { bytes += std::get<std::pmr::string>(msg.data).size(); });
+        }
+      }}};
+      for (size_t i = 0; i < N; i++) {
+        stream.write_sync(std::pmr::string{text, &payloads});
+      }
+      stream.stop();
+    })();
+    std::cout << std::format(
+                     "[heap payloads ] {} bytes, payload allocs = {}, queue allocs = {}, "
+                     "{:.2f} M msg/s\n",
+                     bytes, payloads.allocations(), nodes.allocations(),
+                     N / std::chrono::duration<double>(time).count() / 1e6)
+              << std::flush;
+  }
+
+  {
+    using payload_t = msg::pooled<std::pmr::string>;
+    using msg_t = msg::message<std::variant<std::monostate, payload_t>>;
+    counting_resource payloads;
+    counting_resource nodes;
+    std::pmr::synchronized_pool_resource node_pool{&nodes};
+    sync_stream<msg_t> stream{&node_pool};
+    auto arenas = msg::arena_pool::create((size_t)64 << 10, &payloads);
+    size_t bytes = 0;
+    auto time = timer_wrap([&]() {
+      guarded_thread reader{std::thread{[&]() {
+        while (stream) {
+          stream.drain([&](msg_t&& msg) { bytes += std::get<payload_t>(msg.data)->size(); });
+        }
+      }}};
+      for (size_t i = 0; i < N; i += batch) {
+        auto arena = arenas->acquire();
+        for (size_t j = i; j < std::min(N, i + batch); j++) {
+          stream.write_sync(payload_t{arena, text});
+        }
+      }
+      stream.stop();
+    })();
+    std::cout << std::format(
+                     "[arena payloads] {} bytes, payload allocs = {}, queue allocs = {}, "
+                     "{:.2f} M msg/s, idle arenas = {}\n",
+                     bytes, payloads.allocations(), nodes.allocations(),
+                     N / std::chrono::duration<double>(time).count() / 1e6, arenas->idle())
+              << std::flush;
+  }
+}
+
+namespace {
+
+template <size_t K>
+struct kind_msg {
+  uint64_t value;
+};
+
+}  // namespace
+
+/**
+ * @brief 默认表头 (msg::message) 与紧凑表头 (msg::compact_message) 的每条消息字节数与 stream 吞吐:
+ * 先写满再读空 (队列中积压 M 条, 受内存带宽限制), 以及两个写入方与一个读取方并发
+ */
+void try_msg_stream9() {
+  const size_t M = 2'000'000;
+  using variant_t = std::variant<std::monostate, sum_msg, square_sum_msg>;
+
+  auto bench = [&]<typename stream_t>(std::string tag) {
+    using msg_t = typename stream_t::msg_t;
+    auto throughput = [&](size_t n, auto time) {
+      return n / std::chrono::duration<double>(time).count() / 1e6;
+    };
 
-  messages.emplace_back(3.14, 1);
-  messages.emplace_back(12345, 2);
-  messages.emplace_back("Hello, world!", 3);
-  messages.emplace_back('c', 4);
-  auto arr_ptr = std::make_shared<std::vector<int>>(std::initializer_list{-1, 0, 1});
-  messages.emplace_back(arr_msg{std::move(arr_ptr)}, 5);
-  messages.emplace_back(std::make_pair(2.71828, 3.14159), 6);
-  messages.emplace_back(msg_t{.serial_number = 7});
+    stream_t backlog;
+    size_t sum = 0;
+    auto fill_time = timer_wrap([&]() {
+      for (size_t i = 0; i < M; i++) {
+        backlog.write_sync(sum_msg{i});
+      }
+      backlog.stop();
+    })();
+    auto drain_time = timer_wrap([&]() {
+      while (backlog) {
+        backlog.drain([&](msg_t&& msg) { sum += msg.template get<sum_msg>().value; });
+      }
+    })();
 
-  auto inplace_modify = temp_visitor{[](auto& data) { /* fallback, do nothing */ },
-                                     [](std::string& data) { data += "[suffix]"; },
-                                     [](arr_msg& data) {
-                                       auto& arr = data.data();
-                                       const auto size = arr.size();
-                                       // append #size numbers
-                                       for (size_t i = 0; i < size; i++) {
-                                         arr.emplace_back(1 + *arr.rbegin());
-                                       }
-                                     }};
+    stream_t stream;
+    counter_controller counter{.callback = [&]() { stream.stop(); }};
+    auto concurrent_time = timer_wrap([&]() {
+      std::vector<guarded_thread> writers;
+      for (int w = 0; w < 2; w++) {
+        writers.emplace_back(std::thread{[&]() {
+          counter_controller::guard guard{counter};
+          for (size_t i = 0; i < M / 2; i++) {
+            stream.write_sync(square_sum_msg{i});
+          }
+        }});
+      }
+      std::vector<msg_t> batch;
+      while (stream) {
+        batch.clear();
+        stream.read_many(std::back_inserter(batch), 256);
+        for (const auto& msg : batch) {
+          sum += msg.template get<square_sum_msg>().value;
+        }
+      }
+    })();
 
-  auto output = temp_visitor{[](const auto& data) { /* fallback, do nothing */ },
-                             [](double data) { std::cout << data << std::endl; },
-                             [](int data) { std::cout << data << std::endl; },
-                             [](const std::string& data) { std::cout << data << std::endl; },
-                             [](char data) { std::cout << data << std::endl; },
-                             [](const arr_msg& data) {
-                               const auto& arr = data.data();
-                               for (const auto& item : arr) {
-                                 std::cout << item << " ";
-                               }
-                               std::cout << std::endl;
-                             },
-                             [](const std::pair<double, double>& data) {
-                               std::cout << std::format("({}, {})", data.first, data.second)
-                                         << std::endl;
-                             }};
+    std::cout << std::format(
+                     "{} {} bytes/msg, fill {:.2f} M/s, drain {:.2f} M/s, 2w1r {:.2f} M/s, "
+                     "sum = {}\n",
+                     tag, sizeof(msg_t), throughput(M, fill_time), throughput(M, drain_time),
+                     throughput(M, concurrent_time), sum)
+              << std::flush;
+  };
 
-  std::ranges::sort(messages, std::greater<msg_t>{});  // sort by serial number in descending order
-  // here filter is unnecessary, since visitor has fallback branch. only to show the usage of
-  // msg_t::data_t_in<>();
-  std::ranges::for_each(messages | std::views::filter([](const msg_t& m) {
-                          return m.data_t_in<std::string, arr_msg>();
-                        }),
-                        [&](msg_t& m) { std::visit(std::move(inplace_modify), m.data); });
-  std::ranges::for_each(messages, [&](const msg_t& m) { std::visit(std::move(output), m.data); });
-}
+  for (int round = 0; round < 2; round++) {
+    bench.template operator()<sync_stream<msg::message<variant_t>>>("[message        ]");
+    bench.template operator()<compact_sync_stream<variant_t>>("[compact_message]");
+    bench.template operator()<compact_sync_stream<variant_t, std::chrono::microseconds,
+                                                  cached_timestamp_generator>>(
+        "[compact, cached]");
+  }
 
-namespace {
+  msg::compact_message<variant_t> a{sum_msg{1}, 1, {100}};
+  msg::compact_message<variant_t> b{square_sum_msg{2}, 2, {UINT32_MAX - 10}};
+  std::cout << std::format("a < b: {}, a - b = {}us, a in <sum_msg>: {}\n", a < b,
+                           (a - b)->count(), a.data_t_in<sum_msg>())
+            << std::flush;
+}
 
-struct counter_controller {
-  std::atomic<int> count{0};
-  std::function<void()> callback;
-  operator int() const noexcept {
-    return count;
+/**
+ * @brief msg::router 与 std::visit + temp_visitor (带 fallback 分支) 的分发开销对比,
+ * 消息类型随机; 另测按类型分组的批量分发
+ */
+void try_msg_router() {
+  const size_t N = 10'000'000;
+  using variant_t = std::variant<std::monostate, kind_msg<0>, kind_msg<1>, kind_msg<2>,
+                                 kind_msg<3>, kind_msg<4>, kind_msg<5>, kind_msg<6>>;
+  using msg_t = msg::message<variant_t>;
+
+  std::vector<msg_t> messages(N);
+  std::mt19937_64 gen{42};
+  for (size_t i = 0; i < N; i++) {
+    const uint64_t value = gen();
+    messages[i].data = [&]<size_t... Ks>(std::index_sequence<Ks...>) {
+      variant_t data;
+      ((value % 8 == Ks + 1 ? (void)(data = kind_msg<Ks>{value}) : (void)0), ...);
+      return data;
+    }(std::make_index_sequence<7>{});
   }
-  counter_controller& operator++() noexcept {
-    ++count;
-    return *this;
+
+  uint64_t a = 0, b = 0, c = 0;
+  size_t ignored = 0;
+  auto report = [&](std::string tag, auto time) {
+    std::cout << std::format("{} {:.2f} M msg/s, checksum = {}, ignored = {}\n", tag,
+                             N / std::chrono::duration<double>(time).count() / 1e6, a ^ b ^ c,
+                             ignored)
+              << std::flush;
+    a = b = c = 0;
+    ignored = 0;
+  };
+
+  auto visitor = temp_visitor{[&](const auto&) { ignored++; },
+                              [&](const kind_msg<0>& m) { a += m.value; },
+                              [&](const kind_msg<1>& m) { b ^= m.value; },
+                              [&](const kind_msg<2>& m) { c += m.value >> 3; },
+                              [&](const kind_msg<3>& m) { a += m.value * 3; },
+                              [&](const kind_msg<4>& m) {
+                                b ^= m.value;
+                                c += m.value;
+                              }};
+  auto make_router = [&]() {
+    return msg::router<variant_t>{}
+        .on<kind_msg<0>>([&](const kind_msg<0>& m) { a += m.value; })
+        .on<kind_msg<1>>([&](const kind_msg<1>& m) { b ^= m.value; })
+        .on<kind_msg<2>>([&](const kind_msg<2>& m) { c += m.value >> 3; })
+        .on<kind_msg<3>>([&](const kind_msg<3>& m) { a += m.value * 3; })
+        .on<kind_msg<4>>([&](const kind_msg<4>& m) { b ^= m.value; })
+        .on<kind_msg<4>>([&](const kind_msg<4>& m) { c += m.value; });
+  };
+
+  for (int round = 0; round < 2; round++) {
+    report("[std::visit      ]", timer_wrap([&]() {
+             for (const auto& msg : messages) {
+               std::visit(visitor, msg.data);
+             }
+           })());
+
+    auto route = make_router();
+    auto time = timer_wrap([&]() {
+      for (const auto& msg : messages) {
+        route(msg);
+      }
+    })();
+    ignored = route.unhandled();
+    report("[router          ]", time);
+
+    auto grouped = make_router();
+    time = timer_wrap([&]() {
+      for (size_t i = 0; i < N; i += 256) {
+        grouped.dispatch_grouped(std::span{messages}.subspan(i, std::min<size_t>(256, N - i)));
+      }
+    })();
+    ignored = grouped.unhandled();
+    report("[router, grouped ]", time);
   }
-  counter_controller& operator--() {
-    if (--count == 0) {
-      callback();
+}
+
+/**
+ * @brief try_await 中读取方的聚合 (对 int 和 double 分支求和):
+ * AoS (std::vector<message>) 上逐条 std::visit / get_if, 对比 message_batch 上按列求和
+ */
+void try_msg_batch() {
+  const size_t N = 10'000'000;
+  using msg_t = msg::message<std::variant<std::monostate, int, double>>;
+  using batch_t = msg::message_batch<msg_t::variant_t>;
+
+  std::vector<msg_t> messages(N);
+  std::mt19937_64 gen{42};
+  for (size_t i = 0; i < N; i++) {
+    const uint64_t value = gen();
+    messages[i].serial_number = i + 1;
+    if (value % 16 == 0) {
+      continue;  // monostate
+    }
+    if (value % 2 == 0) {
+      messages[i].data = (int)(value % 100);
+    } else {
+      messages[i].data = (double)(value % 100) * 0.25;
     }
-    return *this;
   }
-  struct guard {
-    counter_controller& ctrl;
-    guard(counter_controller& ctrl) noexcept : ctrl{ctrl} {
-      ++ctrl;
+
+  /**
+   * @brief 4 路部分和, 打破加法的依赖链 (不改变 double 的语义, 编译器不会自动重排)
+   */
+  auto sum_column = [](auto column) {
+    double sums[4]{};
+    size_t i = 0;
+    for (; i + 4 <= column.size(); i += 4) {
+      for (size_t k = 0; k < 4; k++) {
+        sums[k] += (double)column[i + k];
+      }
     }
-    ~guard() {
-      --ctrl;
+    for (; i < column.size(); i++) {
+      sums[0] += (double)column[i];
     }
+    return (sums[0] + sums[1]) + (sums[2] + sums[3]);
   };
-};
-
-struct sum_msg {
-  size_t value;
-};
-
-struct square_sum_msg {
-  size_t value;
-};
-
-}  // namespace
 
-void try_msg_stream() {
-  const auto N = 100'000'000LL;
-  const size_t mod = 998244353;
-  std::vector data{std::from_range, std::views::iota(1LL, N + 1LL)};
+  auto report = [&](std::string tag, double sum, auto time) {
+    std::cout << std::format("{} sum = {}, {:.2f} M msg/s\n", tag, sum,
+                             N / std::chrono::duration<double>(time).count() / 1e6)
+              << std::flush;
+  };
 
-  using msg_t = msg::message<std::variant<std::monostate, sum_msg, square_sum_msg>>;
-  sync_stream<msg_t> stream;
-  counter_controller counter{.callback = [&]() { stream.stop(); }};
+  for (int round = 0; round < 2; round++) {
+    double sum = 0;
+    auto time = timer_wrap([&]() {
+      for (const auto& msg : messages) {
+        std::visit(temp_visitor{[&](int value) { sum += (double)value; },
+                                [&](double value) { sum += value; }, [&](const auto&) {}},
+                   msg.data);
+      }
+    })();
+    report("[AoS std::visit   ]", sum, time);
+
+    sum = 0;
+    time = timer_wrap([&]() {
+      for (const auto& msg : messages) {
+        if (auto* value = std::get_if<int>(&msg.data)) {
+          sum += (double)*value;
+        } else if (auto* value = std::get_if<double>(&msg.data)) {
+          sum += *value;
+        }
+      }
+    })();
+    report("[AoS get_if       ]", sum, time);
 
-  guarded_thread task1{std::thread{[&]() {
-    counter_controller::guard guard{counter};
-    for (int i = 0; i < 5; i++) {
-      stream.write_sync(sum_msg{std::ranges::fold_left(data, (size_t)0, std::plus<size_t>{})});
-    }
-  }}};
+    batch_t batch;
+    time = timer_wrap([&]() { batch.append(messages); })();
+    std::cout << std::format("[AoS -> SoA       ] {} ints, {} doubles, {:.2f} M msg/s\n",
+                             batch.count<int>(), batch.count<double>(),
+                             N / std::chrono::duration<double>(time).count() / 1e6)
+              << std::flush;
 
-  guarded_thread task2{std::thread{[&]() {
-    counter_controller::guard guard{counter};
-    for (int i = 0; i < 5; i++) {
-      stream.write_sync(
-          square_sum_msg{std::ranges::fold_left(data, (size_t)0, [](size_t s, size_t v) {
-            auto res = s + (v * v % mod);
-            res = res >= mod ? res - mod : res;
-            res = res < 0 ? res + mod : res;
-            return res;
-          })});
-    }
-  }}};
+    time = timer_wrap([&]() {
+      sum = sum_column(batch.column<int>()) + sum_column(batch.column<double>());
+    })();
+    report("[SoA column sums  ]", sum, time);
+
+    std::vector<msg_t> restored;
+    time = timer_wrap([&]() { restored = batch.to_messages(); })();
+    const bool same = std::ranges::equal(restored, messages, [](const msg_t& a, const msg_t& b) {
+      return a.serial_number == b.serial_number && a.data == b.data;
+    });
+    std::cout << std::format("[SoA -> AoS       ] same = {}, {:.2f} M msg/s\n", same,
+                             N / std::chrono::duration<double>(time).count() / 1e6)
+              << std::flush;
+  }
 
-  auto output =
-      temp_visitor{[](const auto& data) {},
-                   [](const sum_msg& data) { std::cout << "sum = " << data.value << std::endl; },
-                   [](const square_sum_msg& data) {
-                     std::cout << "moded square sum = " << data.value << std::endl;
-                   }};
-  guarded_thread output_task{std::thread{[&]() {
-    while (stream) {
-      msg_t msg;
-      if (stream.read_sync(msg) == sync_stream<msg_t>::status::good) {
-        std::visit(output, msg.data);
+  {
+    sync_stream<msg_t> stream;
+    double sum = 0;
+    auto time = timer_wrap([&]() {
+      guarded_thread writer{std::thread{[&]() {
+        stream.write_many(messages |
+                          std::views::transform([](const msg_t& msg) { return msg.data; }));
+        stream.stop();
+      }}};
+      batch_t batch;
+      while (stream) {
+        batch.clear();
+        stream.read_many(std::back_inserter(batch), 4096);
+        sum += sum_column(batch.column<int>()) + sum_column(batch.column<double>());
       }
-    }
-  }}};
+    })();
+    report("[stream -> batch  ]", sum, time);
+  }
 }
 
 void try_coroutine() {}
@@ -1625,4 +3382,318 @@ void try_await16() {
   }(stop, timeout, wait_for).get_future().get();
 }
 
+namespace {
+
+struct request_error {
+  int code;
+};
+
+}  // namespace
+
+/**
+ * @brief 错误路径开销对比: 异常 (throw / rethrow_exception) vs result (以值传递错误).
+ * 另外演示 unwrap 的提前返回与 all 在第一个错误处的 short-circuit.
+ */
+void try_await17() {
+  const int N = 1'000'000;
+
+  auto throw_task = [](int i) -> async::co_task_with<int> {
+    if (i % 2 == 0) {
+      throw std::runtime_error("timeout");
+    }
+    co_return i;
+  };
+  auto result_task = [](int i) -> async::co_task_with<async::result<int, request_error>> {
+    if (i % 2 == 0) {
+      co_return async::fail(request_error{.code = 408});
+    }
+    co_return i;
+  };
+
+  auto t1 = timer_wrap([&]() {
+    [](auto& throw_task, int N) -> async::co_task {
+      long long failed = 0;
+      for (int i = 0; i < N; i++) {
+        try {
+          co_await throw_task(i);
+        } catch (const std::runtime_error&) {
+          failed++;
+        }
+      }
+      std::cout << std::format("[exception] failed: {}\n", failed);
+    }(throw_task, N).get_future().get();
+  })();
+  std::cout << std::format("[exception] cost time: {}\n",
+                           std::chrono::duration_cast<std::chrono::milliseconds>(t1));
+
+  auto t2 = timer_wrap([&]() {
+    [](auto& result_task, int N) -> async::co_task {
+      long long failed = 0;
+      for (int i = 0; i < N; i++) {
+        auto res = co_await result_task(i);
+        failed += res.has_value() ? 0 : 1;
+      }
+      std::cout << std::format("[result] failed: {}\n", failed);
+    }(result_task, N).get_future().get();
+  })();
+  std::cout << std::format("[result] cost time: {}\n",
+                           std::chrono::duration_cast<std::chrono::milliseconds>(t2));
+
+  auto sum_task = [](auto& result_task) -> async::co_task_with<async::result<int, request_error>> {
+    int a = co_await async::unwrap(result_task(1));
+    int b = co_await async::unwrap(result_task(2));  // 失败, 直接结束 sum_task
+    std::cout << "unreachable" << std::endl;
+    co_return a + b;
+  }(result_task).get_future().get();
+  std::cout << std::format("[unwrap] error code: {}\n", sum_task.error().code);
+
+  std::latch done{3};  // short-circuit 后其余子任务仍在运行, 返回前等它们全部结束
+  auto sleep_then = [](std::latch& done, int ms,
+                       bool ok) -> async::co_task_with<async::result<int, request_error>> {
+    co_await async::lift([=]() {
+      std::this_thread::sleep_for(std::chrono::milliseconds{ms});
+    }).on(async::trivial_executor);
+    done.count_down();
+    if (!ok) {
+      co_return async::fail(request_error{.code = ms});
+    }
+    co_return ms;
+  };
+  auto t3 = timer_wrap([&]() {
+    [](auto& sleep_then, std::latch& done) -> async::co_task {
+      auto results = co_await async::all(sleep_then(done, 1000, true),
+                                         sleep_then(done, 100, false), sleep_then(done, 500, true));
+      std::cout << std::format("[all] error code: {}\n", results.error().code);
+    }(sleep_then, done).get_future().get();
+  })();
+  std::cout << std::format("[all] short-circuit after: {}\n",
+                           std::chrono::duration_cast<std::chrono::milliseconds>(t3))
+            << std::flush;
+  done.wait();
+}
+
+/**
+ * @brief execute_by 的切换吞吐对比: cancellable_function 类型擦除队列 vs handle-native 队列.
+ */
+void try_await18() {
+  const int N = 1'000'000;
+
+  auto hop = [](auto& executor, int N) -> async::co_task {
+    for (int i = 0; i < N; i++) {
+      co_await async::execute_by(executor);
+    }
+  };
+
+  auto bench = [&](std::string tag, auto& executor) {
+    auto time = timer_wrap([&]() { hop(executor, N).get_future().get(); })();
+    const auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(time);
+    std::cout << std::format("{} {} hops cost time: {}, {:.0f} hops/s\n", tag, N, ms,
+                             N / std::chrono::duration<double>(time).count())
+              << std::flush;
+  };
+
+  for (int i = 0; i < 3; i++) {
+    runner<async::cancellable_function<void>> erased_runner;
+    bench("[cancellable_function]", erased_runner);
+    handle_runner native_runner;
+    bench("[coroutine_handle]", native_runner);
+  }
+
+  // lift(...).on(...) / async_call 同样走 schedule(handle)
+  handle_runner worker;
+  [](auto& worker) -> async::co_task {
+    auto caller = std::this_thread::get_id();
+    auto id = co_await async::async_call([]() { return std::this_thread::get_id(); }, worker);
+    co_await async::lift([]() {}).on(worker);
+    std::cout << std::format("switched to worker: {}\n", caller != id) << std::flush;
+  }(worker).get_future().get();
+}
+
+namespace {
+
+/**
+ * @brief 模拟长尾延迟的服务: 90% 的请求 5~15 ms, 其余服从 Pareto 分布 (最短 50 ms, 最长 1 s).
+ * 响应由 timer_runner 延时 resume, 不占用线程.
+ */
+struct heavy_tailed_service {
+  timer_runner& timer;
+  std::mt19937_64 gen{std::random_device{}()};
+  std::mutex mutex;
+  std::atomic<size_t> calls{0};
+
+  std::chrono::microseconds latency() {
+    std::lock_guard lock{mutex};
+    if (std::uniform_real_distribution<double>{0.0, 1.0}(gen) < 0.9) {
+      return std::chrono::microseconds{std::uniform_int_distribution<int>{5'000, 15'000}(gen)};
+    }
+    const double u = std::uniform_real_distribution<double>{0.0, 1.0}(gen);
+    const double ms = std::min(1000.0, 50.0 / std::pow(1.0 - u, 1.0 / 1.5));
+    return std::chrono::microseconds{(long long)(ms * 1000)};
+  }
+
+  async::co_task_with<int> call(int req, std::stop_token token) {
+    calls++;
+    co_await async::sleep_for(timer, latency());
+    if (token.stop_requested()) {
+      co_return -1;  // 已有其他副本成功, 结果会被丢弃
+    }
+    co_return req;
+  }
+};
+
+}  // namespace
+
+/**
+ * @brief 对冲请求演示: 对比长尾服务在不对冲 / 对冲时的 p50, p99, p999 延迟.
+ */
+void try_await19() {
+  using namespace std::chrono_literals;
+  const int N = 5000;
+  timer_runner timer;
+  heavy_tailed_service service{.timer = timer};
+
+  auto measure = [](auto& service, int id, auto delay, int max_copies,
+                    std::vector<double>& latencies) -> async::co_task {
+    auto start = std::chrono::steady_clock::now();
+    co_await async::hedge(
+        [&service, id](std::stop_token token) { return service.call(id, std::move(token)); },
+        delay, max_copies, service.timer);
+    latencies[id] = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() -
+                                                              start)
+                        .count();
+  };
+
+  auto bench = [&](std::string tag, auto delay, int max_copies) {
+    std::vector<double> latencies(N);
+    service.calls = 0;
+    [](auto& measure, auto& service, auto delay, int max_copies, int N,
+       std::vector<double>& latencies) -> async::co_task {
+      co_await async::all(std::from_range,
+                          std::views::iota(0, N) | std::views::transform([&](int id) {
+                            return measure(service, id, delay, max_copies, latencies);
+                          }));
+    }(measure, service, delay, max_copies, N, latencies).get_future().get();
+    std::ranges::sort(latencies);
+    auto p = [&](double q) { return latencies[std::min(N - 1, (int)(q * N))]; };
+    std::cout << std::format("{} p50: {:.1f} ms, p99: {:.1f} ms, p999: {:.1f} ms, calls: {:.2f}x\n",
+                             tag, p(0.5), p(0.99), p(0.999), (double)service.calls / N)
+              << std::flush;
+  };
+
+  bench("[no hedge]", 0ms, 1);
+  bench("[hedge after 20ms, 2 copies]", 20ms, 2);
+  bench("[hedge after 20ms, 3 copies]", 20ms, 3);
+}
+
+/**
+ * @brief singleflight 演示: 大量协程并发请求少数几个 key, 对比合并前后 factory 的调用次数.
+ */
+void try_await20() {
+  using namespace std::chrono_literals;
+  const int N = 10'000;
+  const int num_keys = 16;
+  timer_runner timer;
+  async::singleflight<int, long long> sf;
+  std::atomic<int> calls{0};
+
+  auto expensive = [&](int key) -> async::co_task_with<long long> {
+    calls++;
+    co_await async::sleep_for(timer, 50ms);  // 模拟耗时的远程调用
+    co_return (long long)key * key;
+  };
+
+  auto bench = [&](std::string tag, bool coalesce) {
+    calls = 0;
+    std::atomic<long long> sum{0};
+    auto time = timer_wrap([&]() {
+      [](auto& sf, auto& expensive, auto& sum, bool coalesce, int N,
+         int num_keys) -> async::co_task {
+        co_await async::all(
+            std::from_range, std::views::iota(0, N) | std::views::transform([&](int i) {
+                               return [](auto& sf, auto& expensive, auto& sum, bool coalesce,
+                                         int key) -> async::co_task {
+                                 if (coalesce) {
+                                   sum += co_await sf.run(key, [&]() { return expensive(key); });
+                                 } else {
+                                   sum += co_await expensive(key);
+                                 }
+                               }(sf, expensive, sum, coalesce, i % num_keys);
+                             }));
+      }(sf, expensive, sum, coalesce, N, num_keys).get_future().get();
+    })();
+    std::cout << std::format("{} {} requests, {} factory calls, sum = {}, cost time: {}\n", tag, N,
+                             calls.load(), sum.load(),
+                             std::chrono::duration_cast<std::chrono::milliseconds>(time))
+              << std::flush;
+  };
+
+  bench("[direct]", false);
+  bench("[singleflight]", true);
+}
+
+/**
+ * @brief async::cache 演示: 热点分布 (Zipf 近似) 的 key 上对比直接加载与缓存,
+ * 输出 hit / miss / eviction 计数; 并演示 TTL 过期后的 stale-while-revalidate.
+ */
+void try_await21() {
+  using namespace std::chrono_literals;
+  const int N = 20'000;
+  const int num_keys = 1000;
+  timer_runner timer;
+  handle_runner refresher;
+  std::atomic<int> calls{0};
+
+  auto load = [&](int key) -> async::co_task_with<std::string> {
+    calls++;
+    co_await async::sleep_for(timer, 1ms);  // 模拟耗时的加载
+    co_return std::format("value-{}", key);
+  };
+
+  // 预先生成热点分布的 key 序列: P(k) ~ 1 / (k + 1)
+  std::vector<int> keys(N);
+  {
+    std::mt19937_64 gen{42};
+    std::vector<double> weights(num_keys);
+    for (int k = 0; k < num_keys; k++) {
+      weights[k] = 1.0 / (k + 1);
+    }
+    std::discrete_distribution<int> dist{weights.begin(), weights.end()};
+    std::ranges::generate(keys, [&]() { return dist(gen); });
+  }
+
+  using cache_t = async::cache<int, std::string>;
+  // 每个条目约 sizeof(int) + sizeof(std::string) 字节, 预算只够容纳约 1/4 的 key
+  cache_t cache{{.byte_budget = num_keys / 4 * (sizeof(int) + sizeof(std::string)), .ttl = 10s}};
+
+  auto time = timer_wrap([&]() {
+    [](auto& cache, auto& load, std::vector<int>& keys) -> async::co_task {
+      for (int key : keys) {
+        co_await cache.get(key, [&load, key]() { return load(key); });
+      }
+    }(cache, load, keys).get_future().get();
+  })();
+  auto stats = cache.stats();
+  std::cout << std::format(
+                   "[cache] {} gets, {} loads, hits: {}, misses: {}, evictions: {}, size: {}, "
+                   "cost time: {}\n",
+                   N, calls.load(), stats.hits, stats.misses, stats.evictions, cache.size(),
+                   std::chrono::duration_cast<std::chrono::milliseconds>(time))
+            << std::flush;
+
+  // stale-while-revalidate
+  cache_t swr_cache{{.ttl = 50ms}};
+  [](auto& cache, auto& load, auto& refresher, auto& timer) -> async::co_task {
+    auto get = [&]() { return cache.get(0, [&load]() { return load(0); }, refresher); };
+    auto v1 = co_await get();  // miss, 同步加载
+    co_await async::sleep_for(timer, 100ms);
+    auto v2 = co_await get();  // 已过期: 立即返回旧值, 后台刷新
+    co_await async::sleep_for(timer, 20ms);
+    auto v3 = co_await get();  // 刷新完成后命中
+    auto stats = cache.stats();
+    std::cout << std::format("[swr] {} / {} / {}, hits: {}, stale hits: {}, misses: {}\n", v1, v2,
+                             v3, stats.hits, stats.stale_hits, stats.misses)
+              << std::flush;
+  }(swr_cache, load, refresher, timer).get_future().get();
+}
+
 }  // namespace playground